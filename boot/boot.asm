@@ -1,16 +1,16 @@
 section .multiboot
 align 4
     dd 0x1BADB002
-    dd 0x00000003
-    dd -(0x1BADB002 + 0x00000003)
+    dd 0x00000007
+    dd -(0x1BADB002 + 0x00000007)
     dd 0
     dd 0
     dd 0
     dd 0
     dd 0
-    dd 1
-    dd 1920
-    dd 1080
+    dd 0
+    dd 1024
+    dd 768
     dd 32
 
 section .text
@@ -171,7 +171,7 @@ long_mode_start:
     
     mov rsp, stack_top
     
-    mov rdi, [multiboot_info]
+    mov edi, [multiboot_info]
     call kernel_main
     
     cli
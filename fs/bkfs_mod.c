@@ -13,13 +13,16 @@
 #include <linux/version.h>
 #include <linux/cred.h>
 #include <linux/backing-dev.h>
+#include <linux/crc32c.h>
 
 #define BKFS_MAGIC 0xBACAF5
+#define BKFS_REV_CSUM 2
 #define BKFS_SUPER_BLOCK 0
 #define BKFS_ROOT_INO 2
 #define BKFS_BLOCK_SIZE 4096
 #define BKFS_FILENAME_LEN 255
 #define BKFS_MAX_EXTENTS 12
+#define BKFS_COMPR_FL 0x00000004
 #define BKFS_INODES_PER_BLOCK (BKFS_BLOCK_SIZE / sizeof(struct bkfs_inode))
 #define BKFS_DEFAULT_MODE 0755
 
@@ -29,6 +32,7 @@ struct bkfs_sb_info {
     uint32_t blocks_count;
     uint32_t inodes_count;
     uint32_t inode_blocks;
+    bool csum;
 };
 
 struct bkfs_inode_info {
@@ -53,7 +57,8 @@ struct bkfs_super_block {
     __le32 s_rev_level;
     __le16 s_def_resuid;
     __le16 s_def_resgid;
-    __le32 s_reserved[236];
+    __le32 s_checksum;
+    __le32 s_reserved[235];
 };
 
 struct bkfs_inode {
@@ -70,7 +75,7 @@ struct bkfs_inode {
     __le32 i_flags;
     __le32 i_block[BKFS_MAX_EXTENTS];
     __le32 i_generation;
-    __le32 i_reserved;
+    __le32 i_checksum;
 };
 
 struct bkfs_dir_entry {
@@ -82,6 +87,38 @@ struct bkfs_dir_entry {
 
 static struct kmem_cache *bkfs_inode_cachep;
 
+static uint32_t bkfs_crc32c(const void *data, size_t len)
+{
+    return ~crc32c(~0U, data, len);
+}
+
+static bool bkfs_inode_csum_ok(const struct bkfs_inode *disk_inode)
+{
+    struct bkfs_inode tmp = *disk_inode;
+
+    tmp.i_checksum = 0;
+    return le32_to_cpu(disk_inode->i_checksum) == bkfs_crc32c(&tmp, sizeof(tmp));
+}
+
+static bool bkfs_super_csum_ok(const struct bkfs_super_block *disk_sb)
+{
+    struct bkfs_super_block *tmp;
+    bool ok;
+
+    tmp = kmemdup(disk_sb, sizeof(*disk_sb), GFP_KERNEL);
+    if (!tmp)
+        return false;
+    tmp->s_checksum = 0;
+    ok = le32_to_cpu(disk_sb->s_checksum) == bkfs_crc32c(tmp, sizeof(*tmp));
+    kfree(tmp);
+    return ok;
+}
+
+static inline struct bkfs_sb_info *BKFS_SB(struct super_block *sb)
+{
+    return sb->s_fs_info;
+}
+
 static inline struct bkfs_inode_info *BKFS_I(struct inode *inode)
 {
     return container_of(inode, struct bkfs_inode_info, vfs_inode);
@@ -150,6 +187,10 @@ static int bkfs_sync_fs(struct super_block *sb, int wait)
     disk_sb->s_free_blocks_count = cpu_to_le32(sbi->free_blocks_count);
     disk_sb->s_free_inodes_count = cpu_to_le32(sbi->free_inodes_count);
     disk_sb->s_mtime = cpu_to_le64(ktime_get_real_seconds());
+    if (sbi->csum) {
+        disk_sb->s_checksum = 0;
+        disk_sb->s_checksum = cpu_to_le32(bkfs_crc32c(disk_sb, sizeof(*disk_sb)));
+    }
     mark_buffer_dirty(bh);
     if (wait)
         sync_dirty_buffer(bh);
@@ -192,6 +233,13 @@ static struct inode *bkfs_iget(struct super_block *sb, unsigned long ino)
     disk_inode = (struct bkfs_inode *)bh->b_data;
     disk_inode += inode_offset;
 
+    if (BKFS_SB(sb)->csum && !bkfs_inode_csum_ok(disk_inode)) {
+        printk(KERN_ERR "bkfs: inode %lu checksum mismatch\n", ino);
+        brelse(bh);
+        iget_failed(inode);
+        return ERR_PTR(-EFSCORRUPTED);
+    }
+
     inode->i_mode = le16_to_cpu(disk_inode->i_mode);
     inode->i_uid = le16_to_cpu(disk_inode->i_uid);
     inode->i_gid = le16_to_cpu(disk_inode->i_gid);
@@ -201,6 +249,7 @@ static struct inode *bkfs_iget(struct super_block *sb, unsigned long ino)
     inode->i_mtime.tv_sec = le32_to_cpu(disk_inode->i_mtime);
     set_nlink(inode, le16_to_cpu(disk_inode->i_links_count));
     inode->i_blocks = le32_to_cpu(disk_inode->i_blocks);
+    BKFS_I(inode)->i_flags = le32_to_cpu(disk_inode->i_flags);
 
     if (S_ISREG(inode->i_mode)) {
         inode->i_op = &simple_dir_inode_operations;
@@ -239,6 +288,12 @@ static int bkfs_fill_super(struct super_block *sb, void *data, int silent)
             printk(KERN_ERR "Wrong magic number\n");
         goto out_bh;
     }
+    sbi->csum = le32_to_cpu(disk_sb->s_rev_level) >= BKFS_REV_CSUM;
+    if (sbi->csum && !bkfs_super_csum_ok(disk_sb)) {
+        if (!silent)
+            printk(KERN_ERR "bkfs: superblock checksum mismatch\n");
+        goto out_bh;
+    }
 
     sbi->free_blocks_count = le32_to_cpu(disk_sb->s_free_blocks_count);
     sbi->free_inodes_count = le32_to_cpu(disk_sb->s_free_inodes_count);
@@ -11,6 +11,7 @@
 #include <linux/fs.h>
 
 #define BKFS_MAGIC 0xBACAF5
+#define BKFS_REV_CSUM 2
 #define BKFS_ROOT_INO 2
 #define BKFS_BLOCK_SIZE 4096
 #define BKFS_FILENAME_LEN 255
@@ -33,7 +34,8 @@ struct mkfs_bkfs_super {
     uint32_t s_rev_level;
     uint16_t s_def_resuid;
     uint16_t s_def_resgid;
-    uint32_t s_reserved[236];
+    uint32_t s_checksum;
+    uint32_t s_reserved[235];
 };
 
 struct mkfs_bkfs_inode {
@@ -50,7 +52,7 @@ struct mkfs_bkfs_inode {
     uint32_t i_flags;
     uint32_t i_block[BKFS_MAX_EXTENTS];
     uint32_t i_generation;
-    uint32_t i_reserved;
+    uint32_t i_checksum;
 };
 
 struct mkfs_bkfs_dir_entry {
@@ -60,6 +62,25 @@ struct mkfs_bkfs_dir_entry {
     char name[BKFS_FILENAME_LEN];
 };
 
+static uint32_t crc32c(const void *data, size_t len)
+{
+    static uint32_t table[256];
+    const uint8_t *p = data;
+    uint32_t crc = 0xFFFFFFFF;
+
+    if (table[1] == 0) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c >> 1) ^ (0x82F63B78 & -(c & 1));
+            table[i] = c;
+        }
+    }
+    while (len--)
+        crc = (crc >> 8) ^ table[(crc ^ *p++) & 0xFF];
+    return ~crc;
+}
+
 static uint64_t get_device_size(int fd)
 {
     uint64_t size = 0;
@@ -74,10 +95,11 @@ static uint64_t get_device_size(int fd)
 
 static void write_superblock(int fd, uint32_t blocks_count)
 {
-    struct mkfs_bkfs_super sb = {0};
+    struct mkfs_bkfs_super sb;
     uint32_t inodes_count = 1024;
     uint32_t inode_blocks = (inodes_count * sizeof(struct mkfs_bkfs_inode) + BKFS_BLOCK_SIZE - 1) / BKFS_BLOCK_SIZE;
 
+    memset(&sb, 0, sizeof(sb));
     sb.s_magic = BKFS_MAGIC;
     sb.s_block_size = BKFS_BLOCK_SIZE;
     sb.s_blocks_count = blocks_count;
@@ -90,9 +112,10 @@ static void write_superblock(int fd, uint32_t blocks_count)
     sb.s_mtime = time(NULL);
     sb.s_state = 1;
     sb.s_creator_os = 0;
-    sb.s_rev_level = 1;
+    sb.s_rev_level = BKFS_REV_CSUM;
     sb.s_def_resuid = 0;
     sb.s_def_resgid = 0;
+    sb.s_checksum = crc32c(&sb, sizeof(sb));
 
     if (pwrite(fd, &sb, sizeof(sb), 0) != sizeof(sb)) {
         perror("Failed to write superblock");
@@ -102,9 +125,10 @@ static void write_superblock(int fd, uint32_t blocks_count)
 
 static void write_root_inode(int fd)
 {
-    struct mkfs_bkfs_inode inode = {0};
+    struct mkfs_bkfs_inode inode;
     uint32_t inode_block = 1;
 
+    memset(&inode, 0, sizeof(inode));
     inode.i_mode = S_IFDIR | 0755;
     inode.i_uid = 0;
     inode.i_gid = 0;
@@ -115,6 +139,7 @@ static void write_root_inode(int fd)
     inode.i_links_count = 2;
     inode.i_blocks = 1;
     inode.i_block[0] = inode_block + 1;
+    inode.i_checksum = crc32c(&inode, sizeof(inode));
 
     if (pwrite(fd, &inode, sizeof(inode), BKFS_BLOCK_SIZE) != sizeof(inode)) {
         perror("Failed to write root inode");
@@ -0,0 +1,412 @@
+#include "../lib/pring.h"
+#include <stddef.h>
+
+#define BENCH_CORPUS_SIZE (64 * 1024)
+#define BENCH_ROUNDS 16
+#define BENCH_IO_ROUNDS 256
+#define BENCH_TTY_KIB 16
+#define BENCH_CONSOLE_FRAMES 32
+#define BENCH_KLOG_CALLS 4096
+#define BENCH_FONT_SWITCHES 64
+#define BENCH_FONT_ID 1
+#define BENCH_MEM_MAX (1024 * 1024)
+#define BENCH_MEM_BYTES (8 * 1024 * 1024)
+#define BENCH_STR_BYTES (1024 * 1024)
+
+static uint8_t bench_corpus[BENCH_CORPUS_SIZE];
+static uint8_t bench_out[BENCH_CORPUS_SIZE + BENCH_CORPUS_SIZE / 255 + 16];
+static uint8_t bench_check[BENCH_CORPUS_SIZE];
+static uint16_t bench_clen[BENCH_CORPUS_SIZE / BKFS_CLUSTER_SIZE];
+
+static uint32_t bench_mb_per_sec(uint64_t bytes, uint64_t cycles) {
+    if (cycles == 0) return 0;
+    return (uint32_t)(bytes * (tsc_calibrate() / 1000) / cycles / 1000);
+}
+
+static uint32_t bench_kb_per_sec(uint64_t bytes, uint64_t cycles) {
+    if (cycles == 0) return 0;
+    return (uint32_t)(bytes * tsc_calibrate() / cycles / 1024);
+}
+
+static uint32_t bench_fill_text(uint8_t* buf, uint32_t size) {
+    const char* words[] = {
+        "the", "kernel", "file", "system", "block", "inode", "root", "srunix",
+        "terminal", "process", "memory", "return", "buffer", "write", "read",
+        "int", "void", "char", "struct", "if", "for", "while", "static"
+    };
+    uint32_t seed = 0x1234567;
+    uint32_t pos = 0;
+    uint32_t line = 0;
+    while (pos < size) {
+        seed = seed * 1103515245 + 12345;
+        const char* w = words[(seed >> 16) % (sizeof(words) / sizeof(words[0]))];
+        while (*w && pos < size) buf[pos++] = *w++;
+        if (pos < size) buf[pos++] = (++line % 9 == 0) ? '\n' : ' ';
+    }
+    return size;
+}
+
+static uint32_t bench_load_file(const char* filename, uint8_t* buf, uint32_t size) {
+    int i = fs_lookup(current_inode, filename);
+    if (i == -1 || files[i].type != FILE_REGULAR) return 0;
+    return fs_read_file(files[i].inode, buf, size);
+}
+
+static void bench_lz4(const char* filename) {
+    uint32_t len;
+    if (filename != NULL) {
+        len = bench_load_file(filename, bench_corpus, BENCH_CORPUS_SIZE);
+        if (len == 0) {
+            terminal_printf("File not found or empty: %s\n", filename);
+            return;
+        }
+    } else {
+        len = bench_fill_text(bench_corpus, BENCH_CORPUS_SIZE);
+    }
+
+    uint32_t clusters = (len + BKFS_CLUSTER_SIZE - 1) / BKFS_CLUSTER_SIZE;
+    uint32_t stored = 0;
+    uint64_t start = rdtsc();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        stored = 0;
+        for (uint32_t c = 0; c < clusters; c++) {
+            uint32_t off = c * BKFS_CLUSTER_SIZE;
+            uint32_t chunk = len - off > BKFS_CLUSTER_SIZE ? BKFS_CLUSTER_SIZE : len - off;
+            int n = lz4_compress(bench_corpus + off, chunk, bench_out + stored, sizeof(bench_out) - stored);
+            bench_clen[c] = n;
+            stored += n;
+        }
+    }
+    uint64_t compress_cycles = rdtsc() - start;
+
+    bool ok = true;
+    start = rdtsc();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        uint32_t in = 0;
+        for (uint32_t c = 0; c < clusters; c++) {
+            uint32_t off = c * BKFS_CLUSTER_SIZE;
+            uint32_t chunk = len - off > BKFS_CLUSTER_SIZE ? BKFS_CLUSTER_SIZE : len - off;
+            if (lz4_decompress(bench_out + in, bench_clen[c], bench_check + off, chunk) != (int)chunk) ok = false;
+            in += bench_clen[c];
+        }
+    }
+    uint64_t decompress_cycles = rdtsc() - start;
+    if (memcmp(bench_corpus, bench_check, len) != 0) ok = false;
+
+    terminal_printf("lz4: %d -> %d bytes, ratio ", len, stored);
+    terminal_print_fixed2(stored ? (uint32_t)((uint64_t)len * 100 / stored) : 0);
+    terminal_printf("\ncompress:   %d MB/s\n", bench_mb_per_sec((uint64_t)len * BENCH_ROUNDS, compress_cycles));
+    terminal_printf("decompress: %d MB/s%s\n", bench_mb_per_sec((uint64_t)len * BENCH_ROUNDS, decompress_cycles),
+                  ok ? "" : " (verify FAILED)");
+}
+
+static void bench_crc() {
+    bench_fill_text(bench_corpus, BENCH_CORPUS_SIZE);
+    uint64_t bytes = (uint64_t)BENCH_CORPUS_SIZE * BENCH_ROUNDS;
+    volatile uint32_t sink = 0;
+    uint64_t start = rdtsc();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        sink ^= crc32c_sw(0xFFFFFFFF, bench_corpus, BENCH_CORPUS_SIZE);
+    }
+    terminal_printf("crc32c table: %d MB/s\n", bench_mb_per_sec(bytes, rdtsc() - start));
+    if (crc32c_hw_available > 0) {
+        start = rdtsc();
+        for (int r = 0; r < BENCH_ROUNDS; r++) {
+            sink ^= crc32c_hw(0xFFFFFFFF, bench_corpus, BENCH_CORPUS_SIZE);
+        }
+        terminal_printf("crc32c sse42: %d MB/s\n", bench_mb_per_sec(bytes, rdtsc() - start));
+    } else {
+        terminal_writestring("crc32c sse42: not supported\n");
+    }
+
+    int ino = fs_alloc_inode();
+    if (ino == -1) {
+        terminal_writestring("No free inodes\n");
+        return;
+    }
+    inodes[ino - 1].mode = 0x8000;
+    uint32_t size = INODE_DIRECT_BLOCKS * BLOCK_SIZE;
+    bool saved = bkfs_csum_enabled;
+    uint64_t cycles[2];
+    for (int pass = 0; pass < 2; pass++) {
+        bkfs_csum_enabled = pass == 1;
+        start = rdtsc();
+        for (int r = 0; r < BENCH_IO_ROUNDS; r++) {
+            fs_write_file(ino, bench_corpus, size);
+            fs_read_file(ino, bench_check, size);
+        }
+        cycles[pass] = rdtsc() - start;
+    }
+    bkfs_csum_enabled = saved;
+    fs_delete_file(ino);
+
+    bytes = (uint64_t)size * 2 * BENCH_IO_ROUNDS;
+    uint32_t overhead = cycles[1] > cycles[0] ? (uint32_t)((cycles[1] - cycles[0]) * 1000 / cycles[0]) : 0;
+    terminal_printf("fs write+read: %d MB/s plain, %d MB/s checksummed\n",
+                  bench_mb_per_sec(bytes, cycles[0]), bench_mb_per_sec(bytes, cycles[1]));
+    terminal_printf("checksum overhead: %d.%d%%\n", overhead / 10, overhead % 10);
+}
+
+static void bench_tty(const char* size_arg) {
+    uint32_t kib = size_arg != NULL ? parse_size(size_arg) : BENCH_TTY_KIB;
+    if (kib == 0 || kib > BENCH_CORPUS_SIZE / 1024) {
+        terminal_printf("Size must be 1-%d KiB\n", BENCH_CORPUS_SIZE / 1024);
+        return;
+    }
+    uint32_t len = bench_fill_text(bench_corpus, kib * 1024);
+    tsc_calibrate();
+
+    uint64_t start = rdtsc();
+    terminal_write((const char*)bench_corpus, len);
+    uint64_t batched = rdtsc() - start;
+
+    start = rdtsc();
+    for (uint32_t i = 0; i < len; i++) {
+        terminal_putchar(bench_corpus[i]);
+    }
+    uint64_t per_char = rdtsc() - start;
+
+    terminal_printf("\ntty: %d KiB\n", kib);
+    terminal_printf("batched write: %d KB/s, %d cycles/byte\n",
+                  bench_kb_per_sec(len, batched), (uint32_t)(batched / len));
+    terminal_printf("per-char:      %d KB/s, %d cycles/byte\n",
+                  bench_kb_per_sec(len, per_char), (uint32_t)(per_char / len));
+}
+
+static void bench_console(const char* frames_arg) {
+    uint32_t frames = frames_arg != NULL ? atoi(frames_arg) : BENCH_CONSOLE_FRAMES;
+    if (frames == 0) frames = BENCH_CONSOLE_FRAMES;
+    if (terminal_tty != &ttys[current_tty]) {
+        terminal_writestring("bench console must run on the foreground tty\n");
+        return;
+    }
+    tsc_calibrate();
+    uint64_t hits = fb_glyph_hits;
+    uint64_t misses = fb_glyph_misses;
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < frames; i++) {
+        terminal_tty->dirty = terminal_all_rows();
+        terminal_flush();
+    }
+    uint64_t cycles = (rdtsc() - start) / frames;
+    terminal_printf("console: %zux%zu cells, %s\n", terminal_width, terminal_height,
+                  fb_console ? "framebuffer" : "vga text");
+    terminal_printf("full frame: %d cycles, %d us\n", (uint32_t)cycles,
+                  (uint32_t)(cycles * 1000000 / tsc_calibrate()));
+    if (fb_console) {
+        terminal_printf("glyph cache: %d hits, %d misses\n",
+                      (uint32_t)(fb_glyph_hits - hits), (uint32_t)(fb_glyph_misses - misses));
+    }
+}
+
+static void bench_klog() {
+    uint64_t start = rdtsc();
+    for (int i = 0; i < BENCH_KLOG_CALLS; i++) {
+        klog(LOG_LEVEL_DEBUG, "bench: klog fixed message");
+    }
+    uint64_t plain = (rdtsc() - start) / BENCH_KLOG_CALLS;
+    start = rdtsc();
+    for (int i = 0; i < BENCH_KLOG_CALLS; i++) {
+        klogf(LOG_LEVEL_DEBUG, "bench: klogf %d", i);
+    }
+    uint64_t formatted = (rdtsc() - start) / BENCH_KLOG_CALLS;
+    terminal_printf("klog:  %d cycles/call\n", (uint32_t)plain);
+    terminal_printf("klogf: %d cycles/call\n", (uint32_t)formatted);
+}
+
+static void bench_font() {
+    if (fb_console) {
+        terminal_writestring("bench font needs the vga text console\n");
+        return;
+    }
+    static uint8_t font[VGA_FONT_SIZE];
+    memcpy(font, old_vga_font, VGA_FONT_SIZE);
+    for (int c = 'A'; c <= 'Z'; c++) {
+        for (int y = 0; y < VGA_FONT_HEIGHT; y++) font[c * VGA_FONT_HEIGHT + y] = fb_font_row(c, y);
+    }
+    if (vga_font_register(BENCH_FONT_ID, font) == -1) {
+        terminal_writestring("font cache full\n");
+        return;
+    }
+    uint32_t uploads = vga_font_uploads;
+    uint64_t start = rdtsc();
+    for (int i = 0; i < BENCH_FONT_SWITCHES; i++) {
+        vga_font_load(i & 1 ? VGA_FONT_ORIGINAL : BENCH_FONT_ID);
+    }
+    uint64_t cycles = (rdtsc() - start) / BENCH_FONT_SWITCHES;
+    vga_restore_font();
+    terminal_printf("font switch: %d cycles, %d glyphs uploaded per switch\n", (uint32_t)cycles,
+                  (vga_font_uploads - uploads) / BENCH_FONT_SWITCHES);
+}
+
+static void bench_bytecopy(uint8_t* d, const uint8_t* s, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        d[i] = s[i];
+        asm volatile ("" : : : "memory");
+    }
+}
+
+static uint32_t bench_mem_rounds(uint32_t size) {
+    uint32_t rounds = BENCH_MEM_BYTES / size;
+    return rounds > 65536 ? 65536 : rounds;
+}
+
+static void bench_mem() {
+    static uint8_t* src = NULL;
+    static uint8_t* dst = NULL;
+    if (src == NULL) {
+        src = malloc(BENCH_MEM_MAX);
+        dst = malloc(BENCH_MEM_MAX);
+        if (src == NULL || dst == NULL) {
+            src = NULL;
+            terminal_writestring("Not enough memory\n");
+            return;
+        }
+        bench_fill_text(src, BENCH_MEM_MAX);
+    }
+    tsc_calibrate();
+    static const uint32_t sizes[] = {1, 8, 32, 128, 512, 4096, 65536, BENCH_MEM_MAX};
+    terminal_printf("ERMS: %s\n", mem_erms ? "yes" : "no");
+    terminal_writestring("   size   memcpy   memset   memcmp  memmove  bytecopy  (MB/s)\n");
+    for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        uint32_t size = sizes[k];
+        uint32_t rounds = bench_mem_rounds(size);
+        uint64_t bytes = (uint64_t)size * rounds;
+        volatile int sink = 0;
+        uint64_t cycles[5];
+
+        uint64_t start = rdtsc();
+        for (uint32_t r = 0; r < rounds; r++) {
+            memcpy(dst, src, size);
+            asm volatile ("" : : : "memory");
+        }
+        cycles[0] = rdtsc() - start;
+        start = rdtsc();
+        for (uint32_t r = 0; r < rounds; r++) {
+            memset(dst, r, size);
+            asm volatile ("" : : : "memory");
+        }
+        cycles[1] = rdtsc() - start;
+        memcpy(dst, src, size);
+        start = rdtsc();
+        for (uint32_t r = 0; r < rounds; r++) {
+            sink += memcmp(dst, src, size);
+            asm volatile ("" : : : "memory");
+        }
+        cycles[2] = rdtsc() - start;
+        start = rdtsc();
+        for (uint32_t r = 0; r < rounds; r++) {
+            memmove(dst + 1, dst, size - 1);
+            asm volatile ("" : : : "memory");
+        }
+        cycles[3] = rdtsc() - start;
+        start = rdtsc();
+        for (uint32_t r = 0; r < rounds; r++) {
+            bench_bytecopy(dst, src, size);
+        }
+        cycles[4] = rdtsc() - start;
+
+        terminal_printf("%7u", size);
+        for (int i = 0; i < 5; i++) {
+            terminal_printf(" %8u", bench_mb_per_sec(bytes, cycles[i]));
+        }
+        terminal_writestring("\n");
+    }
+}
+
+static size_t bench_strlen_ref(const char* str) {
+    size_t len = 0;
+    while (str[len]) len++;
+    return len;
+}
+
+static int bench_strcmp_ref(const char* s1, const char* s2) {
+    while (*s1 && (*s1 == *s2)) {
+        s1++;
+        s2++;
+    }
+    return *(const unsigned char*)s1 - *(const unsigned char*)s2;
+}
+
+static char* bench_strchr_ref(const char* s, int c) {
+    while (*s != '\0') {
+        if (*s == c) return (char*)s;
+        s++;
+    }
+    return NULL;
+}
+
+static int bench_strcasecmp_ref(const char* s1, const char* s2) {
+    while (*s1 && *s2) {
+        char c1 = *s1;
+        char c2 = *s2;
+        if (c1 >= 'A' && c1 <= 'Z') c1 += 32;
+        if (c2 >= 'A' && c2 <= 'Z') c2 += 32;
+        if (c1 != c2) return c1 - c2;
+        s1++;
+        s2++;
+    }
+    return *(const unsigned char*)s1 - *(const unsigned char*)s2;
+}
+
+static void bench_str() {
+    char* a = (char*)bench_corpus;
+    char* b = (char*)bench_check;
+    static const uint32_t sizes[] = {8, 16, 64, 256, 4096};
+    tsc_calibrate();
+    terminal_writestring("   size  strlen old/new  strcmp old/new  strchr old/new  casecmp old/new  (cycles)\n");
+    for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        uint32_t size = sizes[k];
+        for (uint32_t i = 0; i < size; i++) a[i] = b[i] = 'a' + i % 26;
+        a[size] = b[size] = '\0';
+        b[size - 1] = 'A' + (size - 1) % 26;
+        uint32_t rounds = BENCH_STR_BYTES / size;
+        volatile size_t sink = 0;
+        uint64_t cycles[8];
+        uint64_t start;
+#define BENCH_STR(slot, expr) \
+        start = rdtsc(); \
+        for (uint32_t r = 0; r < rounds; r++) { \
+            sink += (size_t)(expr); \
+            asm volatile ("" : : : "memory"); \
+        } \
+        cycles[slot] = (rdtsc() - start) / rounds;
+        BENCH_STR(0, bench_strlen_ref(a));
+        BENCH_STR(1, strlen(a));
+        BENCH_STR(2, bench_strcmp_ref(a, b));
+        BENCH_STR(3, strcmp(a, b));
+        BENCH_STR(4, bench_strchr_ref(a, 'A'));
+        BENCH_STR(5, strchr(a, 'A'));
+        BENCH_STR(6, bench_strcasecmp_ref(a, b));
+        BENCH_STR(7, strcmp_case_insensitive(a, b));
+#undef BENCH_STR
+        terminal_printf("%7u", size);
+        for (int i = 0; i < 8; i += 2) {
+            terminal_printf("  %6u/%-6u", (uint32_t)cycles[i], (uint32_t)cycles[i + 1]);
+        }
+        terminal_writestring("\n");
+    }
+}
+
+void execute_bench(char* name, char* arg) {
+    if (name != NULL && strcmp(name, "lz4") == 0) {
+        bench_lz4(arg);
+    } else if (name != NULL && strcmp(name, "crc") == 0) {
+        bench_crc();
+    } else if (name != NULL && strcmp(name, "tty") == 0) {
+        bench_tty(arg);
+    } else if (name != NULL && strcmp(name, "console") == 0) {
+        bench_console(arg);
+    } else if (name != NULL && strcmp(name, "klog") == 0) {
+        bench_klog();
+    } else if (name != NULL && strcmp(name, "font") == 0) {
+        bench_font();
+    } else if (name != NULL && strcmp(name, "mem") == 0) {
+        bench_mem();
+    } else if (name != NULL && strcmp(name, "str") == 0) {
+        bench_str();
+    } else {
+        terminal_writestring("Usage: bench <test> [args]\n");
+        terminal_writestring("Tests: lz4 [file], crc, tty [KiB], console [frames], klog, font, mem, str\n");
+    }
+}
@@ -2,22 +2,31 @@
 #include <stddef.h>
 
 void execute_cat(char* filename) {
+    if (filename == NULL && terminal_in != NULL) {
+        char buffer[PIPE_BUF_SIZE];
+        int n;
+        while ((n = stream_read(buffer, sizeof(buffer))) > 0) {
+            terminal_write(buffer, n);
+        }
+        return;
+    }
     if (filename == NULL) {
         terminal_writestring("Usage: cat <filename>\n");
         return;
     }
-    for (int i = 0; i < file_count; i++) {
-        if (files[i].parent_inode == current_inode &&
-            strcmp(files[i].name, filename) == 0 &&
-            files[i].type == FILE_REGULAR) {
-            char buffer[BLOCK_SIZE];
-            int bytes_read = fs_read_file(files[i].inode, buffer, sizeof(buffer));
-            if (bytes_read > 0) {
-                terminal_write(buffer, bytes_read);
-            }
-            terminal_writestring("\n");
-            return;
+    int i = fs_lookup(current_inode, filename);
+    if (i != -1 && files[i].type == FILE_REGULAR) {
+        char buffer[BLOCK_SIZE];
+        uint32_t offset = 0;
+        int n;
+        char last = '\n';
+        while ((n = fs_read_range(files[i].inode, offset, buffer, sizeof(buffer))) > 0) {
+            terminal_write(buffer, n);
+            last = buffer[n - 1];
+            offset += n;
         }
+        if (last != '\n' || offset == 0) terminal_writestring("\n");
+        return;
     }
     terminal_printf("File not found: %s\n", filename);
 }
@@ -6,22 +6,18 @@ void execute_cd(char* dirname) {
         return;
     }
     if (strcmp(dirname, "..") == 0) {
-        for (int i = 0; i < file_count; i++) {
-            if (files[i].inode == current_inode) {
-                current_inode = files[i].parent_inode;
-                return;
-            }
+        int i = fs_dirent_of(current_inode);
+        if (i != -1) {
+            current_inode = files[i].parent_inode;
+            return;
         }
         terminal_writestring("Already at root directory\n");
         return;
     }
-    for (int i = 0; i < file_count; i++) {
-        if (files[i].parent_inode == current_inode &&
-            strcmp(files[i].name, dirname) == 0 &&
-            files[i].type == FILE_DIR) {
-            current_inode = files[i].inode;
-            return;
-        }
+    int i = fs_lookup(current_inode, dirname);
+    if (i != -1 && files[i].type == FILE_DIR) {
+        current_inode = files[i].inode;
+        return;
     }
     terminal_writestring("Directory not found: ");
     terminal_writestring(dirname);
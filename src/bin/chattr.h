@@ -0,0 +1,26 @@
+#include "../lib/pring.h"
+#include <stddef.h>
+
+void execute_chattr(char* mode, char* filename) {
+    if (mode == NULL || filename == NULL ||
+        (strcmp(mode, "+c") != 0 && strcmp(mode, "-c") != 0)) {
+        terminal_writestring("Usage: chattr +c|-c <filename>\n");
+        return;
+    }
+    int i = fs_lookup(current_inode, filename);
+    if (i != -1 && files[i].type == FILE_REGULAR) {
+        Inode* inode = &inodes[files[i].inode - 1];
+        uint32_t flags = inode->flags;
+        if (mode[0] == '+') flags |= BKFS_COMPR_FL;
+        else flags &= ~BKFS_COMPR_FL;
+        if (fs_set_flags(files[i].inode, flags) != FS_SUCCESS) {
+            terminal_writestring("Failed to change attributes\n");
+            return;
+        }
+        uint32_t raw_blocks = (inode->size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        terminal_printf("%s: %d bytes, %d/%d blocks stored\n",
+                      filename, inode->size, fs_stored_blocks(files[i].inode), raw_blocks);
+        return;
+    }
+    terminal_printf("File not found: %s\n", filename);
+}
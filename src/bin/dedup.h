@@ -0,0 +1,29 @@
+#include "../lib/pring.h"
+#include <stddef.h>
+
+void execute_dedup(char* arg) {
+    if (arg != NULL) {
+        if (strcmp(arg, "on") == 0) {
+            bkfs_dedup_enabled = true;
+        } else if (strcmp(arg, "off") == 0) {
+            bkfs_dedup_enabled = false;
+        } else {
+            terminal_writestring("Usage: dedup [on|off]\n");
+            return;
+        }
+    }
+    uint32_t physical = 0;
+    uint32_t logical = 0;
+    for (uint32_t i = 0; i < max_blocks; i++) {
+        if (block_used[i]) {
+            physical++;
+            logical += block_refs[i];
+        }
+    }
+    terminal_printf("dedup: %s\n", bkfs_dedup_enabled ? "on" : "off");
+    terminal_printf("blocks: %d logical, %d physical, %d saved\n", logical, physical, logical - physical);
+    terminal_writestring("ratio: ");
+    terminal_print_fixed2(physical ? (uint32_t)((uint64_t)logical * 100 / physical) : 100);
+    terminal_printf("\ntable: %d/%d entries, %d bytes\n", dedup_entries, dedup_table_size, (int)(dedup_table_size * sizeof(DedupEntry)));
+    terminal_printf("hits: %d\n", dedup_hits);
+}
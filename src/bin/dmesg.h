@@ -0,0 +1,45 @@
+#include "../lib/pring.h"
+#include <stddef.h>
+
+static int dmesg_level(const char* name) {
+    if (name[0] >= '0' && name[0] <= '3' && name[1] == '\0') return name[0] - '0';
+    for (int i = 0; i < 4; i++) {
+        if (strcmp_case_insensitive(name, klog_levels[i]) == 0) return i;
+    }
+    return -1;
+}
+
+void execute_dmesg(char** args, int arg_count) {
+    int min_level = LOG_LEVEL_DEBUG;
+    bool clear = false;
+    for (int i = 1; i < arg_count; i++) {
+        if (strcmp(args[i], "-l") == 0 && i + 1 < arg_count) {
+            min_level = dmesg_level(args[++i]);
+            if (min_level < 0) {
+                terminal_printf("Unknown level: %s\n", args[i]);
+                return;
+            }
+        } else if (strcmp(args[i], "-c") == 0) {
+            clear = true;
+        } else if (strcmp(args[i], "-s") == 0 && i + 1 < arg_count) {
+            klog_serial = strcmp(args[++i], "on") == 0;
+            klog_serial_seq = klog_oldest();
+            klog_mirror();
+            return;
+        } else {
+            terminal_writestring("Usage: dmesg [-l debug|info|warn|error] [-c] [-s on|off]\n");
+            return;
+        }
+    }
+    uint32_t head = __atomic_load_n(&klog_head, __ATOMIC_ACQUIRE);
+    uint32_t seq = klog_oldest();
+    if (seq < klog_clear_seq) seq = klog_clear_seq;
+    for (; seq < head; seq++) {
+        KlogEntry e;
+        if (!klog_read(seq, &e) || e.level < min_level) continue;
+        char line[KLOG_MSG_LEN + 32];
+        klog_format(&e, line, sizeof(line));
+        terminal_writestring(line);
+    }
+    if (clear) klog_clear_seq = head;
+}
@@ -0,0 +1,20 @@
+#include "../lib/pring.h"
+#include <stddef.h>
+
+void execute_fallocate(char* flag, char* size_str, char* filename) {
+    if (flag == NULL || size_str == NULL || filename == NULL || strcmp(flag, "-l") != 0) {
+        terminal_writestring("Usage: fallocate -l <size> <filename>\n");
+        return;
+    }
+    int inode_num = size_cmd_lookup(filename);
+    if (inode_num == -1) {
+        terminal_printf("Cannot open: %s\n", filename);
+        return;
+    }
+    if (fs_fallocate(inode_num, parse_size(size_str)) != FS_SUCCESS) {
+        terminal_writestring("Failed to allocate space\n");
+        return;
+    }
+    terminal_printf("%s: %d bytes, %d blocks stored\n",
+                  filename, inodes[inode_num - 1].size, fs_stored_blocks(inode_num));
+}
@@ -63,7 +63,7 @@ void execute_fetch() {
     terminal_setcolor(COLOR_WHITE, COLOR_BLACK);
     terminal_writestring("/dev/tty");
     char tty_num[4];
-    int_to_str(current_tty + 1, tty_num);
+    int_to_str(terminal_tty_index() + 1, tty_num);
     terminal_writestring(tty_num);
     terminal_writestring("\n");
     terminal_setcolor(COLOR_YELLOW, COLOR_BLACK);
@@ -0,0 +1,115 @@
+#include "../lib/pring.h"
+#include <stddef.h>
+
+#define GREP_LINE_MAX 1024
+
+typedef struct {
+    const char* pattern;
+    size_t pattern_len;
+    const char* prefix;
+    bool count_only;
+    bool numbers;
+    uint32_t line;
+    uint32_t matches;
+    char pending[GREP_LINE_MAX];
+    size_t pending_len;
+} GrepState;
+
+static void grep_line(GrepState* g, const char* line, size_t len) {
+    g->line++;
+    if (memmem(line, len, g->pattern, g->pattern_len) == NULL) return;
+    g->matches++;
+    if (g->count_only) return;
+    if (g->prefix != NULL) terminal_printf("%s:", g->prefix);
+    if (g->numbers) terminal_printf("%u:", g->line);
+    terminal_write(line, len);
+    terminal_putchar('\n');
+}
+
+static void grep_feed(GrepState* g, const char* data, size_t len) {
+    while (len > 0) {
+        const char* nl = memchr(data, '\n', len);
+        size_t part = nl != NULL ? (size_t)(nl - data) : len;
+        if (g->pending_len == 0 && nl != NULL) {
+            grep_line(g, data, part);
+        } else {
+            size_t room = GREP_LINE_MAX - g->pending_len;
+            size_t take = part < room ? part : room;
+            memcpy(g->pending + g->pending_len, data, take);
+            g->pending_len += take;
+            if (nl == NULL) break;
+            grep_line(g, g->pending, g->pending_len);
+            g->pending_len = 0;
+        }
+        data += part + 1;
+        len -= part + 1;
+    }
+}
+
+static void grep_finish(GrepState* g) {
+    if (g->pending_len > 0) grep_line(g, g->pending, g->pending_len);
+    if (g->count_only) {
+        if (g->prefix != NULL) terminal_printf("%s:", g->prefix);
+        terminal_printf("%u\n", g->matches);
+    }
+}
+
+static void grep_stream(GrepState* g) {
+    char chunk[PIPE_BUF_SIZE];
+    int n;
+    while ((n = stream_read(chunk, sizeof(chunk))) > 0) {
+        grep_feed(g, chunk, n);
+    }
+    grep_finish(g);
+}
+
+static void grep_file(GrepState* g, const char* filename) {
+    int i = fs_lookup(current_inode, filename);
+    if (i == -1 || files[i].type != FILE_REGULAR) {
+        terminal_printf("grep: %s: No such file\n", filename);
+        return;
+    }
+    char chunk[BKFS_CLUSTER_SIZE];
+    g->line = 0;
+    g->matches = 0;
+    g->pending_len = 0;
+    uint32_t offset = 0;
+    int n;
+    while ((n = fs_read_range(files[i].inode, offset, chunk, sizeof(chunk))) > 0) {
+        grep_feed(g, chunk, n);
+        offset += n;
+        task_yield();
+    }
+    grep_finish(g);
+}
+
+void execute_grep(char** args, int arg_count) {
+    GrepState g;
+    memset(&g, 0, sizeof(g));
+    int i = 1;
+    for (; i < arg_count && args[i][0] == '-' && args[i][1] != '\0'; i++) {
+        for (const char* f = args[i] + 1; *f; f++) {
+            if (*f == 'c') g.count_only = true;
+            else if (*f == 'n') g.numbers = true;
+            else {
+                terminal_printf("grep: unknown option -%c\n", *f);
+                return;
+            }
+        }
+    }
+    if (arg_count - i < 1 || (arg_count - i < 2 && terminal_in == NULL)) {
+        terminal_writestring("Usage: grep [-c] [-n] <pattern> <file>...\n");
+        return;
+    }
+    g.pattern = args[i];
+    g.pattern_len = strlen(args[i]);
+    if (arg_count - i == 1) {
+        grep_stream(&g);
+        return;
+    }
+    bool many = arg_count - i > 2;
+    for (i++; i < arg_count; i++) {
+        g.prefix = many ? args[i] : NULL;
+        grep_file(&g, args[i]);
+    }
+}
@@ -4,55 +4,36 @@
 #include <stddef.h>
 #include "../lib/pring.h"
 
+#define HELP_PAGE_LINES 16
+
 void terminal_writestring(const char* data);
 char keyboard_getchar();
 
 void execute_help(int page) {
-    switch(page) {
-        case 1:
-	    terminal_setcolor(COLOR_BRIGHT_GREEN, COLOR_BLACK);
-            terminal_writestring("Commands (page 1/2):\n");
-	    terminal_setcolor(COLOR_GRAY, COLOR_BLACK);
-            terminal_writestring("help [page] - Show help\n");
-            terminal_writestring("cls - Clear screen\n");
-            terminal_writestring("ver - Show version\n");
-            terminal_writestring("ls - List files\n");
-            terminal_writestring("pwd - Print working directory\n");
-            terminal_writestring("cd - Change directory\n");
-            terminal_writestring("echo - Display message\n");
-            terminal_writestring("cat - Display file contents\n");
-            terminal_writestring("date - Show current date/time\n");
-            terminal_writestring("time - Show current time\n");
-            terminal_writestring("whoami - Show current user\n");
-            terminal_writestring("mem - Show memory usage\n");
-	    terminal_setcolor(COLOR_BRIGHT_GREEN, COLOR_BLACK);
-            terminal_writestring("Type 'help 2' for more commands\n");
-	    terminal_setcolor(COLOR_WHITE, COLOR_BLACK);
-            break;
-        case 2:
-	    terminal_setcolor(COLOR_BRIGHT_GREEN, COLOR_BLACK);
-            terminal_writestring("Commands (page 2/2):\n");
-	    terminal_setcolor(COLOR_GRAY, COLOR_BLACK);
-            terminal_writestring("kptest - Test Kernel Panic\n");
-            terminal_writestring("lsblk - Show disk information\n");
-            terminal_writestring("pause - Wait for keypress\n");
-            terminal_writestring("poweroff - Shut down\n");
-            terminal_writestring("reboot - Reboot\n");
-            terminal_writestring("exit - Log out\n");
-	    terminal_writestring("srunix86 - restart the shell");
-            terminal_writestring("touch - Create file\n");
-	    terminal_writestring("dhcpcd - Automatically configures the fake Internet\n");
-	    terminal_writestring("ping - emulator for sending packets to the server\n");
-            terminal_writestring("mkdir - Create directory\n");
-            terminal_writestring("rm - Delete file (use -rf for directories)\n");
-            terminal_writestring("beep - Play test sound\n");
-            terminal_writestring("smouse - Test a mouse support\n");
-	    terminal_setcolor(COLOR_WHITE, COLOR_BLACK);
-            break;
-        default:
-            terminal_writestring("Invalid help page\n");
-            break;
+    size_t visible = 0;
+    for (size_t i = 0; i < builtin_count; i++) {
+        if (builtins[i].help != NULL) visible++;
+    }
+    int pages = (visible + HELP_PAGE_LINES - 1) / HELP_PAGE_LINES;
+    if (page < 1 || page > pages) {
+        terminal_writestring("Invalid help page\n");
+        return;
+    }
+    terminal_setcolor(COLOR_BRIGHT_GREEN, COLOR_BLACK);
+    terminal_printf("Commands (page %d/%d):\n", page, pages);
+    terminal_setcolor(COLOR_GRAY, COLOR_BLACK);
+    size_t first = (page - 1) * HELP_PAGE_LINES;
+    size_t n = 0;
+    for (size_t i = 0; i < builtin_count && n < first + HELP_PAGE_LINES; i++) {
+        if (builtins[i].help == NULL) continue;
+        if (n++ < first) continue;
+        terminal_printf("%s - %s\n", builtins[i].name, builtins[i].help);
+    }
+    if (page < pages) {
+        terminal_setcolor(COLOR_BRIGHT_GREEN, COLOR_BLACK);
+        terminal_printf("Type 'help %d' for more commands\n", page + 1);
     }
+    terminal_setcolor(COLOR_WHITE, COLOR_BLACK);
 }
 
 #endif
@@ -0,0 +1,67 @@
+#include "../lib/pring.h"
+#include <stddef.h>
+
+static void history_load_line(void* ctx, char* line, uint32_t line_no) {
+    (void)ctx;
+    (void)line_no;
+    if (line == NULL) return;
+    size_t len = strlen(line);
+    if (len > 0 && line[len - 1] == '\r') line[len - 1] = '\0';
+    history_add(line);
+}
+
+static void history_save(const char* filename) {
+    int i = fs_resolve(current_inode, filename);
+    if (i == -1) {
+        if (fs_create_file(filename, current_inode, FILE_REGULAR) != FS_SUCCESS) return;
+        i = fs_lookup(current_inode, filename);
+    }
+    if (i == -1 || files[i].type != FILE_REGULAR) {
+        terminal_printf("history: %s: Not a regular file\n", filename);
+        return;
+    }
+    BkfsWriter w;
+    if (fs_writer_open(&w, files[i].inode, false) != FS_SUCCESS) {
+        terminal_printf("history: %s: Cannot open file\n", filename);
+        return;
+    }
+    for (int k = 0; k < history_count; k++) {
+        const char* entry = history_entry(k);
+        fs_writer_write(&w, entry, strlen(entry));
+        fs_writer_write(&w, "\n", 1);
+    }
+    if (fs_writer_close(&w) != FS_SUCCESS) {
+        terminal_printf("history: %s: File too large or disk full\n", filename);
+    }
+}
+
+static void history_load(const char* filename) {
+    int i = fs_resolve(current_inode, filename);
+    if (i == -1 || files[i].type != FILE_REGULAR) {
+        terminal_printf("history: %s: No such file\n", filename);
+        return;
+    }
+    fs_read_lines(files[i].inode, history_load_line, NULL);
+}
+
+void execute_history(char** args, int arg_count) {
+    if (arg_count == 1) {
+        for (int k = 0; k < history_count; k++) {
+            terminal_printf("%5d  %s\n", k + 1, history_entry(k));
+        }
+        return;
+    }
+    if (strcmp(args[1], "-c") == 0) {
+        history_clear();
+        return;
+    }
+    if (arg_count == 3 && strcmp(args[1], "-w") == 0) {
+        history_save(args[2]);
+        return;
+    }
+    if (arg_count == 3 && strcmp(args[1], "-r") == 0) {
+        history_load(args[2]);
+        return;
+    }
+    terminal_writestring("Usage: history [-c] [-w file] [-r file]\n");
+}
@@ -4,17 +4,14 @@ void execute_pwd() {
     char path[MAX_PATH_LEN] = "/";
     uint32_t inode = current_inode;
     while (inode != 1) {
-        for (int i = 0; i < file_count; i++) {
-            if (files[i].inode == inode) {
-                char temp[MAX_PATH_LEN];
-                strcpy(temp, "/");
-                strcat(temp, files[i].name);
-                strcat(temp, path);
-                strcpy(path, temp);
-                inode = files[i].parent_inode;
-                break;
-            }
-        }
+        int i = fs_dirent_of(inode);
+        if (i == -1) break;
+        char temp[MAX_PATH_LEN];
+        strcpy(temp, "/");
+        strcat(temp, files[i].name);
+        strcat(temp, path);
+        strcpy(path, temp);
+        inode = files[i].parent_inode;
     }
     terminal_writestring("");
     terminal_writestring(path);
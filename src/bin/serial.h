@@ -0,0 +1,45 @@
+#include "../lib/pring.h"
+#include <stddef.h>
+
+void execute_serial(char* mode, char* tty_str) {
+    if (mode == NULL) {
+        if (!serial_present) {
+            terminal_writestring("COM1: not present\n");
+            return;
+        }
+        terminal_printf("COM1: %d baud 8N1, FIFO %d\n", 115200 / SERIAL_BAUD_DIVISOR, serial_fifo_depth);
+        if (serial_tty != NULL) {
+            terminal_printf("tty%d: %s\n", (int)(serial_tty - ttys) + 1,
+                          serial_mode == SERIAL_REDIRECT ? "redirect" : "mirror");
+        } else {
+            terminal_writestring("no tty attached\n");
+        }
+        terminal_printf("tx %d bytes, rx %d bytes, dropped tx %d rx %d, queued %d\n",
+                      serial_tx_bytes, serial_rx_bytes, serial_dropped, serial_rx_dropped,
+                      serial_tx_head - serial_tx_tail);
+        return;
+    }
+    if (strcmp(mode, "off") == 0) {
+        serial_tty = NULL;
+        serial_mode = SERIAL_OFF;
+        return;
+    }
+    uint8_t new_mode;
+    if (strcmp(mode, "mirror") == 0) new_mode = SERIAL_MIRROR;
+    else if (strcmp(mode, "redirect") == 0) new_mode = SERIAL_REDIRECT;
+    else {
+        terminal_writestring("Usage: serial [mirror|redirect|off] [tty]\n");
+        return;
+    }
+    if (!serial_present) {
+        terminal_writestring("COM1: not present\n");
+        return;
+    }
+    int tty = tty_str != NULL ? atoi(tty_str) - 1 : terminal_tty_index();
+    if (tty < 0 || tty >= MAX_TTYS) {
+        terminal_printf("tty must be 1-%d\n", MAX_TTYS);
+        return;
+    }
+    serial_tty = &ttys[tty];
+    serial_mode = new_mode;
+}
@@ -0,0 +1,24 @@
+#include "../lib/pring.h"
+#include <stddef.h>
+
+static int size_cmd_lookup(const char* filename) {
+    int i = fs_lookup(current_inode, filename);
+    if (i != -1) return files[i].type == FILE_REGULAR ? (int)files[i].inode : -1;
+    if (fs_create_file(filename, current_inode, FILE_REGULAR) != FS_SUCCESS) return -1;
+    return files[file_count - 1].inode;
+}
+
+void execute_truncate(char* flag, char* size_str, char* filename) {
+    if (flag == NULL || size_str == NULL || filename == NULL || strcmp(flag, "-s") != 0) {
+        terminal_writestring("Usage: truncate -s <size> <filename>\n");
+        return;
+    }
+    int inode_num = size_cmd_lookup(filename);
+    if (inode_num == -1) {
+        terminal_printf("Cannot open: %s\n", filename);
+        return;
+    }
+    if (fs_truncate(inode_num, parse_size(size_str)) != FS_SUCCESS) {
+        terminal_writestring("Failed to truncate file\n");
+    }
+}
@@ -0,0 +1,50 @@
+#include "../lib/pring.h"
+#include <stddef.h>
+
+typedef struct {
+    uint32_t lines;
+    uint32_t words;
+    uint32_t bytes;
+    bool in_word;
+} WcCount;
+
+static void wc_feed(WcCount* wc, const char* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        char c = data[i];
+        if (c == '\n') wc->lines++;
+        bool space = c == ' ' || c == '\n' || c == '\t' || c == '\r';
+        if (!space && !wc->in_word) wc->words++;
+        wc->in_word = !space;
+    }
+    wc->bytes += len;
+}
+
+void execute_wc(char** args, int arg_count) {
+    WcCount wc = {0};
+    char chunk[PIPE_BUF_SIZE];
+    if (arg_count > 1) {
+        int i = fs_lookup(current_inode, args[1]);
+        if (i == -1 || files[i].type != FILE_REGULAR) {
+            terminal_printf("wc: %s: No such file\n", args[1]);
+            return;
+        }
+        uint32_t offset = 0;
+        int n;
+        while ((n = fs_read_range(files[i].inode, offset, chunk, sizeof(chunk))) > 0) {
+            wc_feed(&wc, chunk, n);
+            offset += n;
+            task_yield();
+        }
+        terminal_printf("%7u %7u %7u %s\n", wc.lines, wc.words, wc.bytes, args[1]);
+        return;
+    }
+    if (terminal_in == NULL) {
+        terminal_writestring("Usage: wc <file> or cmd | wc\n");
+        return;
+    }
+    int n;
+    while ((n = stream_read(chunk, sizeof(chunk))) > 0) {
+        wc_feed(&wc, chunk, n);
+    }
+    terminal_printf("%7u %7u %7u\n", wc.lines, wc.words, wc.bytes);
+}
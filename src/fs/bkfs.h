@@ -1,8 +1,161 @@
 #include <stddef.h>
 #include "../lib/pring.h"
+
+static uint32_t fs_inode_checksum(Inode* inode) {
+    uint32_t saved = inode->checksum;
+    inode->checksum = 0;
+    uint32_t crc = crc32c(inode, sizeof(Inode));
+    inode->checksum = saved;
+    return crc;
+}
+
+static void fs_inode_seal(Inode* inode) {
+    if (bkfs_csum_enabled) inode->checksum = fs_inode_checksum(inode);
+}
+
+static bool fs_inode_verify(Inode* inode) {
+    if (!bkfs_csum_enabled || inode->checksum == fs_inode_checksum(inode)) return true;
+    terminal_printf("bkfs: inode %d checksum mismatch\n", (int)(inode - inodes) + 1);
+    return false;
+}
+
+static bool fs_block_verify(uint32_t block_num) {
+    if (!bkfs_csum_enabled || block_crc[block_num] == crc32c(blocks[block_num], BLOCK_SIZE)) return true;
+    terminal_printf("bkfs: block %d checksum mismatch\n", block_num);
+    return false;
+}
+
+static uint32_t inode_hint = 0;
+static uint32_t block_hint = BKFS_HOLE + 1;
+
+static uint32_t fs_pow2(uint32_t n) {
+    uint32_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+int fs_init_tables() {
+    size_t per_block = BLOCK_SIZE + sizeof(bool) + sizeof(uint32_t) + sizeof(uint16_t) + 2 * sizeof(DedupEntry);
+    size_t per_inode = sizeof(Inode) + sizeof(File) + sizeof(uint32_t) + 2 * sizeof(DirentEntry);
+    size_t budget = (heap_end - heap_start) / 100 * BKFS_MEM_PERCENT;
+    size_t count = budget / (per_block * BKFS_BLOCKS_PER_INODE + per_inode);
+    max_inodes = count > BKFS_MIN_INODES ? count : BKFS_MIN_INODES;
+    max_files = max_inodes + file_count;
+    max_blocks = max_inodes * BKFS_BLOCKS_PER_INODE;
+    if (max_blocks < BKFS_MIN_BLOCKS) max_blocks = BKFS_MIN_BLOCKS;
+    dedup_table_size = fs_pow2(max_blocks * 2);
+    dirent_index_size = fs_pow2(max_files * 2);
+
+    blocks = malloc((size_t)max_blocks * BLOCK_SIZE);
+    block_used = calloc(max_blocks, sizeof(bool));
+    block_crc = calloc(max_blocks, sizeof(uint32_t));
+    block_refs = calloc(max_blocks, sizeof(uint16_t));
+    dedup_table = calloc(dedup_table_size, sizeof(DedupEntry));
+    inodes = calloc(max_inodes, sizeof(Inode));
+    inode_dirent = calloc(max_inodes, sizeof(uint32_t));
+    files = calloc(max_files, sizeof(File));
+    dirent_index = calloc(dirent_index_size, sizeof(DirentEntry));
+    if (!blocks || !block_used || !block_crc || !block_refs || !dedup_table ||
+        !inodes || !inode_dirent || !files || !dirent_index) {
+        return FS_ERROR;
+    }
+    free_blocks = max_blocks - 1;
+    free_inodes = max_inodes;
+    return FS_SUCCESS;
+}
+
+static uint32_t fs_name_hash(uint32_t parent_inode, const char* name) {
+    uint32_t h = 2166136261U ^ parent_inode;
+    while (*name) {
+        h ^= (uint8_t)*name++;
+        h *= 16777619U;
+    }
+    return h;
+}
+
+int fs_lookup(uint32_t parent_inode, const char* name) {
+    uint32_t mask = dirent_index_size - 1;
+    uint32_t hash = fs_name_hash(parent_inode, name);
+    for (uint32_t i = hash & mask; dirent_index[i].file != 0; i = (i + 1) & mask) {
+        File* f = &files[dirent_index[i].file - 1];
+        if (dirent_index[i].hash == hash && f->parent_inode == parent_inode && strcmp(f->name, name) == 0) {
+            return dirent_index[i].file - 1;
+        }
+    }
+    return -1;
+}
+
+int fs_dirent_of(uint32_t inode_num) {
+    if (inode_num == 0 || inode_num > max_inodes) return -1;
+    return (int)inode_dirent[inode_num - 1] - 1;
+}
+
+int fs_resolve(uint32_t dir, const char* path) {
+    if (*path == '/') dir = 1;
+    int idx = -1;
+    while (*path) {
+        while (*path == '/') path++;
+        size_t len = 0;
+        while (path[len] && path[len] != '/') len++;
+        if (len == 0) break;
+        char name[32];
+        if (len >= sizeof(name)) return -1;
+        memcpy(name, path, len);
+        name[len] = '\0';
+        path += len;
+        idx = fs_lookup(dir, name);
+        if (idx == -1 || (*path == '/' && files[idx].type != FILE_DIR)) return -1;
+        dir = files[idx].inode;
+    }
+    return idx;
+}
+
+static void fs_index_insert(int idx) {
+    uint32_t mask = dirent_index_size - 1;
+    uint32_t hash = fs_name_hash(files[idx].parent_inode, files[idx].name);
+    uint32_t i = hash & mask;
+    while (dirent_index[i].file != 0) i = (i + 1) & mask;
+    dirent_index[i].hash = hash;
+    dirent_index[i].file = idx + 1;
+    inode_dirent[files[idx].inode - 1] = idx + 1;
+}
+
+static uint32_t fs_index_slot(int idx) {
+    uint32_t mask = dirent_index_size - 1;
+    uint32_t i = fs_name_hash(files[idx].parent_inode, files[idx].name) & mask;
+    while (dirent_index[i].file != (uint32_t)idx + 1) i = (i + 1) & mask;
+    return i;
+}
+
+static void fs_index_remove(int idx) {
+    uint32_t mask = dirent_index_size - 1;
+    uint32_t i = fs_index_slot(idx);
+    uint32_t j = i;
+    inode_dirent[files[idx].inode - 1] = 0;
+    while (1) {
+        dirent_index[i].file = 0;
+        uint32_t k;
+        do {
+            j = (j + 1) & mask;
+            if (dirent_index[j].file == 0) return;
+            k = dirent_index[j].hash & mask;
+        } while (i <= j ? (i < k && k <= j) : (i < k || k <= j));
+        dirent_index[i] = dirent_index[j];
+        i = j;
+    }
+}
+
+static void fs_index_move(int from, int to) {
+    dirent_index[fs_index_slot(from)].file = to + 1;
+    files[to] = files[from];
+    inode_dirent[files[to].inode - 1] = to + 1;
+}
+
 int fs_alloc_inode() {
     if (free_inodes == 0) return -1;
-    for (int i = 0; i < MAX_INODES; i++) {
+    for (uint32_t n = 0; n < max_inodes; n++) {
+        uint32_t i = inode_hint;
+        inode_hint = i + 1 < max_inodes ? i + 1 : 0;
         if (inodes[i].mode == 0) {
             memset(&inodes[i], 0, sizeof(Inode));
             inodes[i].mode = 1;
@@ -14,16 +167,19 @@ int fs_alloc_inode() {
 }
 
 void fs_free_inode(uint32_t inode_num) {
-    if (inode_num == 0 || inode_num > MAX_INODES) return;
+    if (inode_num == 0 || inode_num > max_inodes) return;
     memset(&inodes[inode_num - 1], 0, sizeof(Inode));
     free_inodes++;
 }
 
 int fs_alloc_block() {
     if (free_blocks == 0) return -1;
-    for (int i = 0; i < MAX_BLOCKS; i++) {
+    for (uint32_t n = BKFS_HOLE + 1; n < max_blocks; n++) {
+        uint32_t i = block_hint;
+        block_hint = i + 1 < max_blocks ? i + 1 : BKFS_HOLE + 1;
         if (!block_used[i]) {
             block_used[i] = true;
+            block_refs[i] = 1;
             free_blocks--;
             return i;
         }
@@ -31,12 +187,88 @@ int fs_alloc_block() {
     return -1;
 }
 
+static int fs_dedup_lookup(uint32_t hash, uint32_t block_num) {
+    uint32_t mask = dedup_table_size - 1;
+    for (uint32_t i = hash & mask; dedup_table[i].block != 0; i = (i + 1) & mask) {
+        uint32_t candidate = dedup_table[i].block - 1;
+        if (dedup_table[i].hash == hash && candidate != block_num && block_used[candidate] &&
+            memcmp(blocks[candidate], blocks[block_num], BLOCK_SIZE) == 0) {
+            return candidate;
+        }
+    }
+    return -1;
+}
+
+static void fs_dedup_insert(uint32_t hash, uint32_t block_num) {
+    uint32_t mask = dedup_table_size - 1;
+    if (dedup_entries >= dedup_table_size - 1) return;
+    uint32_t i = hash & mask;
+    while (dedup_table[i].block != 0) i = (i + 1) & mask;
+    dedup_table[i].hash = hash;
+    dedup_table[i].block = block_num + 1;
+    dedup_entries++;
+}
+
+static void fs_dedup_remove(uint32_t block_num) {
+    uint32_t mask = dedup_table_size - 1;
+    uint32_t hash = crc32c(blocks[block_num], BLOCK_SIZE);
+    uint32_t i = hash & mask;
+    while (dedup_table[i].block != block_num + 1) {
+        if (dedup_table[i].block == 0) return;
+        i = (i + 1) & mask;
+    }
+    uint32_t j = i;
+    while (1) {
+        dedup_table[i].block = 0;
+        uint32_t k;
+        do {
+            j = (j + 1) & mask;
+            if (dedup_table[j].block == 0) {
+                dedup_entries--;
+                return;
+            }
+            k = dedup_table[j].hash & mask;
+        } while (i <= j ? (i < k && k <= j) : (i < k || k <= j));
+        dedup_table[i] = dedup_table[j];
+        i = j;
+    }
+}
+
 void fs_free_block(uint32_t block_num) {
-    if (block_num >= MAX_BLOCKS) return;
+    if (block_num == BKFS_HOLE || block_num >= max_blocks || !block_used[block_num]) return;
+    if (block_refs[block_num] > 1) {
+        block_refs[block_num]--;
+        return;
+    }
+    if (dedup_entries) fs_dedup_remove(block_num);
+    block_refs[block_num] = 0;
     block_used[block_num] = false;
     free_blocks++;
 }
 
+static int fs_store_block(const void* data, uint32_t len) {
+    int block_num = fs_alloc_block();
+    if (block_num == -1) return -1;
+    memcpy(blocks[block_num], data, len);
+    memset(blocks[block_num] + len, 0, BLOCK_SIZE - len);
+    if (!bkfs_dedup_enabled && !bkfs_csum_enabled) return block_num;
+    uint32_t hash = crc32c(blocks[block_num], BLOCK_SIZE);
+    if (bkfs_dedup_enabled) {
+        int dup = fs_dedup_lookup(hash, block_num);
+        if (dup != -1 && block_refs[dup] < 0xFFFF) {
+            block_used[block_num] = false;
+            block_refs[block_num] = 0;
+            free_blocks++;
+            block_refs[dup]++;
+            dedup_hits++;
+            return dup;
+        }
+        fs_dedup_insert(hash, block_num);
+    }
+    if (bkfs_csum_enabled) block_crc[block_num] = hash;
+    return block_num;
+}
+
 int fs_create_file(const char* name, uint32_t parent_inode, uint8_t type) {
     if (!is_valid_filename(name)) {
         terminal_writestring("Invalid filename: contains forbidden characters\n");
@@ -48,7 +280,7 @@ int fs_create_file(const char* name, uint32_t parent_inode, uint8_t type) {
         return FS_ERROR;
     }
 
-    if (file_count >= MAX_FILES) return FS_ERROR;
+    if ((uint32_t)file_count >= max_files) return FS_ERROR;
     int inode_num = fs_alloc_inode();
     if (inode_num == -1) return FS_ERROR;
     strncpy(files[file_count].name, name, 31);
@@ -65,6 +297,8 @@ int fs_create_file(const char* name, uint32_t parent_inode, uint8_t type) {
     inode->ctime = timer_ticks;
     inode->mtime = timer_ticks;
     inode->blocks = 0;
+    fs_inode_seal(inode);
+    fs_index_insert(file_count);
     file_count++;
     if (file_count == 0) {
 	    terminal_setcolor(COLOR_RED, COLOR_BLACK);
@@ -74,21 +308,16 @@ int fs_create_file(const char* name, uint32_t parent_inode, uint8_t type) {
 }
 
 int fs_delete_file(uint32_t inode_num) {
-    if (inode_num == 0 || inode_num > MAX_INODES) return FS_ERROR;
+    if (inode_num == 0 || inode_num > max_inodes) return FS_ERROR;
     Inode* inode = &inodes[inode_num - 1];
     for (uint32_t i = 0; i < inode->blocks && i < INODE_DIRECT_BLOCKS; i++) {
-        if (inode->block[i] != 0) {
-            fs_free_block(inode->block[i]);
-        }
+        fs_free_block(inode->block[i]);
     }
-    for (int i = 0; i < file_count; i++) {
-        if (files[i].inode == inode_num) {
-            for (int j = i; j < file_count - 1; j++) {
-                files[j] = files[j + 1];
-            }
-            file_count--;
-            break;
-        }
+    int idx = fs_dirent_of(inode_num);
+    if (idx != -1) {
+        fs_index_remove(idx);
+        file_count--;
+        if (idx != file_count) fs_index_move(file_count, idx);
     }
     if (file_count == 0) {
 	    terminal_setcolor(COLOR_RED, COLOR_BLACK);
@@ -98,59 +327,435 @@ int fs_delete_file(uint32_t inode_num) {
     return FS_SUCCESS;
 }
 
+static uint8_t bkfs_cluster_buf[BKFS_CLUSTER_SIZE];
+static uint8_t bkfs_plain_buf[BKFS_CLUSTER_SIZE];
+static uint8_t bkfs_file_buf[INODE_DIRECT_BLOCKS * BLOCK_SIZE];
+
+static bool fs_is_zero(const void* data, uint32_t len) {
+    const uint8_t* p = data;
+    while (len >= sizeof(uint64_t)) {
+        uint64_t v;
+        __builtin_memcpy(&v, p, sizeof(v));
+        if (v) return false;
+        p += sizeof(v);
+        len -= sizeof(v);
+    }
+    while (len--) {
+        if (*p++) return false;
+    }
+    return true;
+}
+
+static void fs_release_blocks(Inode* inode) {
+    for (uint32_t i = 0; i < inode->blocks && i < INODE_DIRECT_BLOCKS; i++) {
+        fs_free_block(inode->block[i]);
+        inode->block[i] = BKFS_HOLE;
+    }
+    inode->blocks = 0;
+}
+
+static uint32_t fs_block_at(Inode* inode, uint32_t slot) {
+    return slot < inode->blocks ? inode->block[slot] : BKFS_HOLE;
+}
+
+static bool fs_copy_block(uint8_t* out, uint32_t block_num, uint32_t len) {
+    if (block_num == BKFS_HOLE) {
+        memset(out, 0, len);
+        return true;
+    }
+    if (!fs_block_verify(block_num)) return false;
+    memcpy(out, blocks[block_num], len);
+    return true;
+}
+
+static int fs_store_cluster(Inode* inode, uint32_t c, const uint8_t* raw, uint32_t raw_len) {
+    inode->clen[c] = 0;
+    if (fs_is_zero(raw, raw_len)) return FS_SUCCESS;
+    uint32_t raw_blocks = (raw_len + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    int clen = lz4_compress(raw, raw_len, bkfs_cluster_buf, (raw_blocks - 1) * BLOCK_SIZE);
+    const uint8_t* src = raw;
+    uint32_t len = raw_len;
+    if (clen > 0) {
+        src = bkfs_cluster_buf;
+        len = clen;
+        inode->clen[c] = clen;
+    }
+    uint32_t nblocks = (len + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    for (uint32_t b = 0; b < nblocks; b++) {
+        uint32_t to_copy = len - b * BLOCK_SIZE;
+        if (to_copy > BLOCK_SIZE) to_copy = BLOCK_SIZE;
+        if (clen <= 0 && fs_is_zero(src + b * BLOCK_SIZE, to_copy)) continue;
+        int block_num = fs_store_block(src + b * BLOCK_SIZE, to_copy);
+        if (block_num == -1) return FS_ERROR;
+        uint32_t slot = c * BKFS_CLUSTER_BLOCKS + b;
+        inode->block[slot] = block_num;
+        inode->blocks = slot + 1;
+    }
+    return FS_SUCCESS;
+}
+
+static int fs_store_raw(Inode* inode, uint32_t slot, const void* data, uint32_t len) {
+    if (fs_is_zero(data, len)) return FS_SUCCESS;
+    int block_num = fs_store_block(data, len);
+    if (block_num == -1) return FS_ERROR;
+    inode->block[slot] = block_num;
+    inode->blocks = slot + 1;
+    return FS_SUCCESS;
+}
+
+static int fs_write_compressed(Inode* inode, const void* data, uint32_t size) {
+    uint32_t clusters = (size + BKFS_CLUSTER_SIZE - 1) / BKFS_CLUSTER_SIZE;
+    memset(inode->clen, 0, sizeof(inode->clen));
+    for (uint32_t c = 0; c < clusters; c++) {
+        uint32_t raw_len = size - c * BKFS_CLUSTER_SIZE;
+        if (raw_len > BKFS_CLUSTER_SIZE) raw_len = BKFS_CLUSTER_SIZE;
+        if (fs_store_cluster(inode, c, (const uint8_t*)data + c * BKFS_CLUSTER_SIZE, raw_len) != FS_SUCCESS) {
+            fs_release_blocks(inode);
+            return FS_ERROR;
+        }
+    }
+    inode->size = size;
+    inode->mtime = timer_ticks;
+    return FS_SUCCESS;
+}
+
+static int fs_write_raw(Inode* inode, const void* data, uint32_t size) {
+    uint32_t blocks_needed = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    for (uint32_t i = 0; i < blocks_needed; i++) {
+        uint32_t to_copy = size - i * BLOCK_SIZE;
+        if (to_copy > BLOCK_SIZE) to_copy = BLOCK_SIZE;
+        if (fs_store_raw(inode, i, (const char*)data + i * BLOCK_SIZE, to_copy) != FS_SUCCESS) {
+            fs_release_blocks(inode);
+            return FS_ERROR;
+        }
+    }
+    inode->size = size;
+    inode->mtime = timer_ticks;
+    return FS_SUCCESS;
+}
+
 int fs_write_file(uint32_t inode_num, const void* data, uint32_t size) {
-    if (inode_num == 0 || inode_num > MAX_INODES) return FS_ERROR;
+    if (inode_num == 0 || inode_num > max_inodes) return FS_ERROR;
     Inode* inode = &inodes[inode_num - 1];
     uint32_t blocks_needed = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
     if (blocks_needed > INODE_DIRECT_BLOCKS) return FS_ERROR;
-    for (uint32_t i = 0; i < inode->blocks; i++) {
-        if (inode->block[i] != 0) {
-            fs_free_block(inode->block[i]);
+    fs_release_blocks(inode);
+    int ret;
+    if (inode->flags & BKFS_COMPR_FL) {
+        ret = fs_write_compressed(inode, data, size);
+    } else {
+        ret = fs_write_raw(inode, data, size);
+    }
+    fs_inode_seal(inode);
+    return ret;
+}
+
+static int fs_read_compressed(Inode* inode, void* buffer, uint32_t size) {
+    uint32_t done = 0;
+    for (uint32_t c = 0; done < size; c++) {
+        uint32_t raw_len = inode->size - c * BKFS_CLUSTER_SIZE;
+        if (raw_len > BKFS_CLUSTER_SIZE) raw_len = BKFS_CLUSTER_SIZE;
+        uint32_t want = size - done;
+        if (want > raw_len) want = raw_len;
+        uint32_t first = c * BKFS_CLUSTER_BLOCKS;
+        uint8_t* out = (uint8_t*)buffer + done;
+        if (inode->clen[c] == 0) {
+            for (uint32_t off = 0; off < want; off += BLOCK_SIZE) {
+                uint32_t to_copy = want - off > BLOCK_SIZE ? BLOCK_SIZE : want - off;
+                if (!fs_copy_block(out + off, fs_block_at(inode, first + off / BLOCK_SIZE), to_copy)) {
+                    return done + off;
+                }
+            }
+        } else {
+            uint32_t clen = inode->clen[c];
+            for (uint32_t off = 0; off < clen; off += BLOCK_SIZE) {
+                uint32_t to_copy = clen - off > BLOCK_SIZE ? BLOCK_SIZE : clen - off;
+                if (!fs_copy_block(bkfs_cluster_buf + off, fs_block_at(inode, first + off / BLOCK_SIZE), to_copy)) {
+                    return done;
+                }
+            }
+            uint8_t* dst = want == raw_len ? out : bkfs_plain_buf;
+            if (lz4_decompress(bkfs_cluster_buf, clen, dst, raw_len) != (int)raw_len) {
+                break;
+            }
+            if (dst != out) memcpy(out, dst, want);
         }
+        done += want;
     }
-    for (uint32_t i = 0; i < blocks_needed; i++) {
+    return done;
+}
+
+int fs_read_file(uint32_t inode_num, void* buffer, uint32_t size) {
+    if (inode_num == 0 || inode_num > max_inodes) return FS_ERROR;
+    Inode* inode = &inodes[inode_num - 1];
+    if (!fs_inode_verify(inode)) return 0;
+    if (size > inode->size) size = inode->size;
+    inode->atime = timer_ticks;
+    fs_inode_seal(inode);
+    if (inode->flags & BKFS_COMPR_FL) {
+        return fs_read_compressed(inode, buffer, size);
+    }
+    uint32_t remaining = size;
+    for (uint32_t i = 0; remaining > 0; i++) {
+        uint32_t to_copy = remaining > BLOCK_SIZE ? BLOCK_SIZE : remaining;
+        if (!fs_copy_block((uint8_t*)buffer + i * BLOCK_SIZE, fs_block_at(inode, i), to_copy)) {
+            return size - remaining;
+        }
+        remaining -= to_copy;
+    }
+    return size;
+}
+
+int fs_read_range(uint32_t inode_num, uint32_t offset, void* buffer, uint32_t size) {
+    if (inode_num == 0 || inode_num > max_inodes) return FS_ERROR;
+    Inode* inode = &inodes[inode_num - 1];
+    if (!fs_inode_verify(inode) || offset >= inode->size) return 0;
+    if (size > inode->size - offset) size = inode->size - offset;
+    uint32_t done = 0;
+    while (done < size) {
+        uint32_t pos = offset + done;
+        uint8_t* out = (uint8_t*)buffer + done;
+        uint32_t c = pos / BKFS_CLUSTER_SIZE;
+        if ((inode->flags & BKFS_COMPR_FL) && inode->clen[c] != 0) {
+            uint32_t raw_len = inode->size - c * BKFS_CLUSTER_SIZE;
+            if (raw_len > BKFS_CLUSTER_SIZE) raw_len = BKFS_CLUSTER_SIZE;
+            uint32_t clen = inode->clen[c];
+            for (uint32_t off = 0; off < clen; off += BLOCK_SIZE) {
+                uint32_t to_copy = clen - off > BLOCK_SIZE ? BLOCK_SIZE : clen - off;
+                if (!fs_copy_block(bkfs_cluster_buf + off, fs_block_at(inode, c * BKFS_CLUSTER_BLOCKS + off / BLOCK_SIZE), to_copy)) {
+                    return done;
+                }
+            }
+            if (lz4_decompress(bkfs_cluster_buf, clen, bkfs_plain_buf, raw_len) != (int)raw_len) return done;
+            uint32_t in = pos - c * BKFS_CLUSTER_SIZE;
+            uint32_t want = raw_len - in < size - done ? raw_len - in : size - done;
+            memcpy(out, bkfs_plain_buf + in, want);
+            done += want;
+            continue;
+        }
+        uint32_t in = pos % BLOCK_SIZE;
+        uint32_t want = BLOCK_SIZE - in < size - done ? BLOCK_SIZE - in : size - done;
+        uint8_t* dst = in == 0 ? out : bkfs_plain_buf;
+        if (!fs_copy_block(dst, fs_block_at(inode, pos / BLOCK_SIZE), in + want)) return done;
+        if (dst != out) memcpy(out, dst + in, want);
+        done += want;
+    }
+    inode->atime = timer_ticks;
+    fs_inode_seal(inode);
+    return done;
+}
+
+int fs_read_lines(uint32_t inode_num, line_fn fn, void* ctx) {
+    char chunk[BLOCK_SIZE];
+    char text[MAX_CMD_LEN];
+    size_t len = 0;
+    bool overflow = false;
+    uint32_t line_no = 0;
+    uint32_t offset = 0;
+    int n;
+    while ((n = fs_read_range(inode_num, offset, chunk, sizeof(chunk))) > 0) {
+        offset += n;
+        const char* data = chunk;
+        size_t left = n;
+        while (left > 0) {
+            const char* nl = memchr(data, '\n', left);
+            size_t part = nl != NULL ? (size_t)(nl - data) : left;
+            if (len + part < MAX_CMD_LEN) {
+                memcpy(text + len, data, part);
+                len += part;
+            } else {
+                overflow = true;
+            }
+            if (nl == NULL) break;
+            text[len] = '\0';
+            fn(ctx, overflow ? NULL : text, ++line_no);
+            len = 0;
+            overflow = false;
+            data += part + 1;
+            left -= part + 1;
+        }
+    }
+    if (n < 0) return FS_ERROR;
+    if (len > 0 || overflow) {
+        text[len] = '\0';
+        fn(ctx, overflow ? NULL : text, ++line_no);
+    }
+    return FS_SUCCESS;
+}
+
+static int fs_writer_flush(BkfsWriter* w) {
+    Inode* inode = &inodes[w->inode - 1];
+    int ret;
+    if (inode->flags & BKFS_COMPR_FL) {
+        ret = fs_store_cluster(inode, w->base / BKFS_CLUSTER_SIZE, w->buf, w->len);
+    } else {
+        ret = fs_store_raw(inode, w->base / BLOCK_SIZE, w->buf, w->len);
+    }
+    if (ret != FS_SUCCESS) {
+        w->error = true;
+        return FS_ERROR;
+    }
+    inode->size = w->base + w->len;
+    inode->mtime = timer_ticks;
+    fs_inode_seal(inode);
+    return FS_SUCCESS;
+}
+
+int fs_writer_open(BkfsWriter* w, uint32_t inode_num, bool append) {
+    if (inode_num == 0 || inode_num > max_inodes) return FS_ERROR;
+    Inode* inode = &inodes[inode_num - 1];
+    if (!fs_inode_verify(inode)) return FS_ERROR;
+    w->inode = inode_num;
+    w->unit = (inode->flags & BKFS_COMPR_FL) ? BKFS_CLUSTER_SIZE : BLOCK_SIZE;
+    w->base = append ? inode->size - inode->size % w->unit : 0;
+    w->len = 0;
+    w->error = false;
+    if (append && w->base < inode->size) {
+        w->len = inode->size - w->base;
+        if (fs_read_range(inode_num, w->base, w->buf, w->len) != (int)w->len) return FS_ERROR;
+    }
+    uint32_t first = w->base / BLOCK_SIZE;
+    for (uint32_t i = first; i < inode->blocks && i < INODE_DIRECT_BLOCKS; i++) {
+        fs_free_block(inode->block[i]);
+        inode->block[i] = BKFS_HOLE;
+    }
+    if (inode->blocks > first) inode->blocks = first;
+    for (uint32_t c = w->base / BKFS_CLUSTER_SIZE; c < BKFS_CLUSTERS; c++) inode->clen[c] = 0;
+    inode->size = w->base;
+    inode->mtime = timer_ticks;
+    fs_inode_seal(inode);
+    return FS_SUCCESS;
+}
+
+int fs_writer_write(BkfsWriter* w, const void* data, uint32_t size) {
+    const uint8_t* p = data;
+    while (size > 0 && !w->error) {
+        if (w->base + w->len >= INODE_DIRECT_BLOCKS * BLOCK_SIZE) {
+            w->error = true;
+            break;
+        }
+        uint32_t n = w->unit - w->len < size ? w->unit - w->len : size;
+        memcpy(w->buf + w->len, p, n);
+        w->len += n;
+        p += n;
+        size -= n;
+        if (w->len == w->unit) {
+            if (fs_writer_flush(w) != FS_SUCCESS) break;
+            w->base += w->unit;
+            w->len = 0;
+        }
+    }
+    return w->error ? FS_ERROR : FS_SUCCESS;
+}
+
+int fs_writer_close(BkfsWriter* w) {
+    if (w->len > 0 && !w->error) fs_writer_flush(w);
+    return w->error ? FS_ERROR : FS_SUCCESS;
+}
+
+int fs_set_flags(uint32_t inode_num, uint32_t flags) {
+    if (inode_num == 0 || inode_num > max_inodes) return FS_ERROR;
+    Inode* inode = &inodes[inode_num - 1];
+    if (inode->flags == flags) return FS_SUCCESS;
+    uint32_t size = fs_read_file(inode_num, bkfs_file_buf, sizeof(bkfs_file_buf));
+    if (size != inode->size) return FS_ERROR;
+    uint32_t old_flags = inode->flags;
+    inode->flags = flags;
+    if (fs_write_file(inode_num, bkfs_file_buf, size) != FS_SUCCESS) {
+        inode->flags = old_flags;
+        fs_write_file(inode_num, bkfs_file_buf, size);
+        return FS_ERROR;
+    }
+    return FS_SUCCESS;
+}
+
+int fs_truncate(uint32_t inode_num, uint32_t size) {
+    if (inode_num == 0 || inode_num > max_inodes) return FS_ERROR;
+    if (size > INODE_DIRECT_BLOCKS * BLOCK_SIZE) return FS_ERROR;
+    Inode* inode = &inodes[inode_num - 1];
+    if (!fs_inode_verify(inode)) return FS_ERROR;
+    if (inode->flags & BKFS_COMPR_FL) {
+        uint32_t old_size = fs_read_file(inode_num, bkfs_file_buf, sizeof(bkfs_file_buf));
+        if (old_size != inode->size) return FS_ERROR;
+        if (size > old_size) memset(bkfs_file_buf + old_size, 0, size - old_size);
+        return fs_write_file(inode_num, bkfs_file_buf, size);
+    }
+    uint32_t keep = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    for (uint32_t i = keep; i < inode->blocks; i++) {
+        fs_free_block(inode->block[i]);
+        inode->block[i] = BKFS_HOLE;
+    }
+    if (inode->blocks > keep) inode->blocks = keep;
+    uint32_t tail = size % BLOCK_SIZE;
+    uint32_t last = fs_block_at(inode, keep - 1);
+    if (size < inode->size && tail != 0 && last != BKFS_HOLE) {
+        if (!fs_copy_block(bkfs_cluster_buf, last, tail)) return FS_ERROR;
+        int block_num = BKFS_HOLE;
+        if (!fs_is_zero(bkfs_cluster_buf, tail)) {
+            block_num = fs_store_block(bkfs_cluster_buf, tail);
+            if (block_num == -1) return FS_ERROR;
+        }
+        fs_free_block(last);
+        inode->block[keep - 1] = block_num;
+    }
+    inode->size = size;
+    inode->mtime = timer_ticks;
+    fs_inode_seal(inode);
+    return FS_SUCCESS;
+}
+
+// Reserves zeroed blocks up to size. The next fs_write_file rewrites the whole
+// file and stores all-zero blocks as holes again, dropping the reservation.
+int fs_fallocate(uint32_t inode_num, uint32_t size) {
+    if (inode_num == 0 || inode_num > max_inodes) return FS_ERROR;
+    if (size > INODE_DIRECT_BLOCKS * BLOCK_SIZE) return FS_ERROR;
+    Inode* inode = &inodes[inode_num - 1];
+    if (!fs_inode_verify(inode) || (inode->flags & BKFS_COMPR_FL)) return FS_ERROR;
+    uint32_t needed = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    uint32_t old_blocks = inode->blocks;
+    uint32_t filled = 0;
+    for (uint32_t i = inode->blocks; i < needed; i++) {
+        inode->block[i] = BKFS_HOLE;
+    }
+    if (inode->blocks < needed) inode->blocks = needed;
+    for (uint32_t i = 0; i < needed; i++) {
+        if (inode->block[i] != BKFS_HOLE) continue;
         int block_num = fs_alloc_block();
         if (block_num == -1) {
             for (uint32_t j = 0; j < i; j++) {
+                if (!(filled & (1u << j))) continue;
                 fs_free_block(inode->block[j]);
+                inode->block[j] = BKFS_HOLE;
             }
+            inode->blocks = old_blocks;
+            fs_inode_seal(inode);
             return FS_ERROR;
         }
+        filled |= 1u << i;
+        memset(blocks[block_num], 0, BLOCK_SIZE);
+        if (bkfs_csum_enabled) block_crc[block_num] = crc32c(blocks[block_num], BLOCK_SIZE);
         inode->block[i] = block_num;
     }
-    inode->blocks = blocks_needed;
-    inode->size = size;
+    if (size > inode->size) inode->size = size;
     inode->mtime = timer_ticks;
-    uint32_t remaining = size;
-    for (uint32_t i = 0; i < blocks_needed; i++) {
-        uint32_t to_copy = remaining > BLOCK_SIZE ? BLOCK_SIZE : remaining;
-        memcpy(blocks[inode->block[i]], (char*)data + i * BLOCK_SIZE, to_copy);
-        remaining -= to_copy;
-    }
+    fs_inode_seal(inode);
     return FS_SUCCESS;
 }
 
-int fs_read_file(uint32_t inode_num, void* buffer, uint32_t size) {
-    if (inode_num == 0 || inode_num > MAX_INODES) return FS_ERROR;
+uint32_t fs_stored_blocks(uint32_t inode_num) {
+    if (inode_num == 0 || inode_num > max_inodes) return 0;
     Inode* inode = &inodes[inode_num - 1];
-    if (size > inode->size) size = inode->size;
-    uint32_t remaining = size;
-    for (uint32_t i = 0; i < inode->blocks && remaining > 0; i++) {
-        uint32_t to_copy = remaining > BLOCK_SIZE ? BLOCK_SIZE : remaining;
-        memcpy((char*)buffer + i * BLOCK_SIZE, blocks[inode->block[i]], to_copy);
-        remaining -= to_copy;
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < inode->blocks && i < INODE_DIRECT_BLOCKS; i++) {
+        if (inode->block[i] != BKFS_HOLE) count++;
     }
-    inode->atime = timer_ticks;
-    return size;
+    return count;
 }
 
 int fs_change_dir(uint32_t inode_num) {
-    for (int i = 0; i < file_count; i++) {
-        if (files[i].inode == inode_num && files[i].type == FILE_DIR) {
-            current_inode = inode_num;
-            return FS_SUCCESS;
-        }
-    }
-    return FS_ERROR;
+    int i = fs_dirent_of(inode_num);
+    if (i == -1 || files[i].type != FILE_DIR) return FS_ERROR;
+    current_inode = inode_num;
+    return FS_SUCCESS;
 }
 
@@ -112,28 +112,3 @@ void execute_ping(char* host) {
     terminal_writestring("");
     terminal_writestring("3 packets transmitted, 3 received, 0% packet loss\n");
 }
-
-void vga_save_current_font(uint8_t* buffer) {
-    outb(0x3C4, 0x04); 
-    outb(0x3C4, 0x02); 
-    outb(0x3CE, 0x04); 
-    outb(0x3CE, 0x02); 
-    outb(0x3CE, 0x05); 
-    outb(0x3CE, 0x00); 
-    outb(0x3CE, 0x06); 
-    outb(0x3CE, 0x00); 
-
-    volatile uint8_t* font_mem = (volatile uint8_t*)0xA0000;
-    for (int i = 0; i < VGA_FONT_SIZE; i++) {
-        buffer[i] = font_mem[i];
-    }
-
-    outb(0x3C4, 0x03); 
-    outb(0x3C4, 0x00);
-    outb(0x3CE, 0x04); 
-    outb(0x3CE, 0x00);
-    outb(0x3CE, 0x05);
-    outb(0x3CE, 0x10);
-    outb(0x3CE, 0x06);
-    outb(0x3CE, 0x0E);
-}
@@ -1,6 +1,16 @@
 #include "../lib/pring.h"
 #include "../lib/prdio.h"
 #include "../lib/prddef.h"
+#include "../lib/lz4.h"
+#include "../lib/crc32c.h"
+#include "../lib/task.h"
+#include "../lib/pipe.h"
+#include "../lib/job.h"
+#include "../lib/history.h"
+#include "../lib/serial.h"
+#include "../lib/fb.h"
+#include "../lib/klog.h"
+#include "../lib/vgafont.h"
 #include "../fs/bkfs.h"
 #include "../bin/beep.h"
 #include "../bin/ls.h"
@@ -13,224 +23,32 @@
 #include "../bin/Z.h"
 #include "../internet/internet.h"
 #include "../bin/pc.h"
-#include "kernel.h"
-
-void vga_set_font(const uint8_t* new_font) {
-    vga_save_current_font(old_vga_font);
-
-    outb(0x3C4, 0x04); 
-    outb(0x3C4, 0x02); 
-    outb(0x3CE, 0x04); 
-    outb(0x3CE, 0x02); 
-    outb(0x3CE, 0x05); 
-    outb(0x3CE, 0x00); 
-    outb(0x3CE, 0x06); 
-    outb(0x3CE, 0x00); 
-
-    volatile uint8_t* font_mem = (volatile uint8_t*)0xA0000;
-    for (int i = 0; i < VGA_FONT_SIZE; i++) {
-        font_mem[i] = new_font[i];
-    }
-
-    outb(0x3C4, 0x03); 
-    outb(0x3C4, 0x00);
-    outb(0x3CE, 0x04); 
-    outb(0x3CE, 0x00);
-    outb(0x3CE, 0x05);
-    outb(0x3CE, 0x10);
-    outb(0x3CE, 0x06);
-    outb(0x3CE, 0x0E);
-
-    outb(0x3D4, 0x09); 
-    outb(0x3D5, 0x00); 
-}
-
-void execute_append_output(char* filename, char* text) {
-    if (filename == NULL || text == NULL) {
-        terminal_writestring("Usage: echo text >> filename\n");
-        return;
-    }
-    for (int i = 0; i < file_count; i++) {
-        if (files[i].parent_inode == current_inode && 
-            strcmp(files[i].name, filename) == 0 && 
-            files[i].type == FILE_REGULAR) {
-            char current_content[MAX_FILE_SIZE];
-            uint32_t bytes_read = fs_read_file(files[i].inode, current_content, MAX_FILE_SIZE - 1);
-            current_content[bytes_read] = '\0';
-            char new_content[MAX_FILE_SIZE];
-            strcpy(new_content, current_content);
-            if (bytes_read > 0 && current_content[bytes_read - 1] != '\n') {
-                strcat(new_content, "\n");
-            }
-            strcat(new_content, text);
-            if (fs_write_file(files[i].inode, new_content, strlen(new_content)) == FS_SUCCESS) {
-            } else {
-                terminal_writestring("Failed to append to file\n");
-            }
-            return;
-        }
-    }
-    if (fs_create_file(filename, current_inode, FILE_REGULAR) == FS_SUCCESS) {
-        if (fs_write_file(files[file_count-1].inode, text, strlen(text)) == FS_SUCCESS) {
-            terminal_writestring("File created and text written\n");
-        } else {
-            terminal_writestring("File created but failed to write text\n");
-        }
-    } else {
-        terminal_writestring("Failed to create file\n");
-    }
-}
-
-void execute_cat_redirect(char* source_file, char* dest_file, bool append) {
-    if (source_file == NULL || dest_file == NULL) {
-        terminal_writestring("Usage: cat <source_file> > <dest_file> or cat <source_file> >> <dest_file>\n");
-        return;
-    }
-    char source_content[MAX_FILE_SIZE];
-    uint32_t bytes_read = 0;
-    bool source_found = false;
-    for (int i = 0; i < file_count; i++) {
-        if (files[i].parent_inode == current_inode && 
-            strcmp(files[i].name, source_file) == 0 && 
-            files[i].type == FILE_REGULAR) {
-            bytes_read = fs_read_file(files[i].inode, source_content, MAX_FILE_SIZE - 1);
-            source_found = true;
-            break;
-        }
-    }
-    if (!source_found || bytes_read == 0) {
-        terminal_printf("Source file not found or empty: %s\n", source_file);
-        return;
-    }
-    source_content[bytes_read] = '\0';
-    bool dest_found = false;
-    uint32_t dest_inode = 0;
-    for (int i = 0; i < file_count; i++) {
-        if (files[i].parent_inode == current_inode && 
-            strcmp(files[i].name, dest_file) == 0 && 
-            files[i].type == FILE_REGULAR) {
-            dest_found = true;
-            dest_inode = files[i].inode;
-            break;
-        }
-    }
-    if (append) {
-        if (dest_found) {
-            char dest_content[MAX_FILE_SIZE];
-            uint32_t dest_bytes = fs_read_file(dest_inode, dest_content, MAX_FILE_SIZE - 1);
-            dest_content[dest_bytes] = '\0';
-            char new_content[MAX_FILE_SIZE];
-            strcpy(new_content, dest_content);
-            if (dest_bytes > 0 && dest_content[dest_bytes - 1] != '\n') {
-                strcat(new_content, "\n");
-            }
-            strcat(new_content, source_content);
-            if (fs_write_file(dest_inode, new_content, strlen(new_content)) == FS_SUCCESS) {
-                terminal_printf("Content from %s appended to %s\n", source_file, dest_file);
-            } else {
-                terminal_writestring("Failed to append to file\n");
-            }
-        } else {
-            if (fs_create_file(dest_file, current_inode, FILE_REGULAR) == FS_SUCCESS) {
-                for (int i = 0; i < file_count; i++) {
-                    if (files[i].parent_inode == current_inode && 
-                        strcmp(files[i].name, dest_file) == 0 && 
-                        files[i].type == FILE_REGULAR) {
-                        if (fs_write_file(files[i].inode, source_content, strlen(source_content)) == FS_SUCCESS) {
-                            terminal_printf("File %s created with content from %s\n", dest_file, source_file);
-                        } else {
-                            terminal_writestring("File created but failed to write content\n");
-                        }
-                        break;
-                    }
-                }
-            } else {
-                terminal_writestring("Failed to create file\n");
-            }
-        }
-    } else {
-        if (dest_found) {
-            if (fs_write_file(dest_inode, source_content, strlen(source_content)) == FS_SUCCESS) {
-                terminal_printf("Content from %s written to %s\n", source_file, dest_file);
-            } else {
-                terminal_writestring("Failed to write to file\n");
-            }
-        } else {
-            if (fs_create_file(dest_file, current_inode, FILE_REGULAR) == FS_SUCCESS) {
-                for (int i = 0; i < file_count; i++) {
-                    if (files[i].parent_inode == current_inode && 
-                        strcmp(files[i].name, dest_file) == 0 && 
-                        files[i].type == FILE_REGULAR) {
-                        if (fs_write_file(files[i].inode, source_content, strlen(source_content)) == FS_SUCCESS) {
-                            terminal_printf("File %s created with content from %s\n", dest_file, source_file);
-                        } else {
-                            terminal_writestring("File created but failed to write content\n");
-                        }
-                        break;
-                    }
-                }
-            } else {
-                terminal_writestring("Failed to create file\n");
-            }
-        }
-    }
-}
-
+#include "../bin/chattr.h"
+#include "../bin/dedup.h"
+#include "../bin/bench.h"
+#include "../bin/truncate.h"
+#include "../bin/fallocate.h"
+#include "../bin/serial.h"
+#include "../bin/dmesg.h"
+#include "../bin/grep.h"
+#include "../bin/wc.h"
+#include "../bin/history.h"
 
 void execute_date() {
-    uint8_t second = cmos_read(0x00);
-    uint8_t minute = cmos_read(0x02);
-    uint8_t hour = cmos_read(0x04);
-    uint8_t day = cmos_read(0x07);
-    uint8_t month = cmos_read(0x08);
-    uint8_t year = cmos_read(0x09);
-    second = bcd_to_bin(second);
-    minute = bcd_to_bin(minute);
-    hour = bcd_to_bin(hour);
-    day = bcd_to_bin(day);
-    month = bcd_to_bin(month);
-    year = bcd_to_bin(year);
-    char hour_str[3], min_str[3], sec_str[3];
-    int_to_str(hour, hour_str);
-    int_to_str(minute, min_str);
-    int_to_str(second, sec_str);
-    char day_str[3], month_str[3], year_str[5];
-    int_to_str(day, day_str);
-    int_to_str(month, month_str);
-    int_to_str(year + 2000, year_str);
-    terminal_writestring("");
-    terminal_writestring(day_str);
-    terminal_writestring("/");
-    terminal_writestring(month_str);
-    terminal_writestring("/");
-    terminal_writestring(year_str);
-    terminal_writestring(" ");
-    terminal_writestring(hour_str);
-    terminal_writestring(":");
-    terminal_writestring(min_str);
-    terminal_writestring(":");
-    terminal_writestring(sec_str);
-    terminal_writestring("\n");
+    uint8_t second = bcd_to_bin(cmos_read(0x00));
+    uint8_t minute = bcd_to_bin(cmos_read(0x02));
+    uint8_t hour = bcd_to_bin(cmos_read(0x04));
+    uint8_t day = bcd_to_bin(cmos_read(0x07));
+    uint8_t month = bcd_to_bin(cmos_read(0x08));
+    uint8_t year = bcd_to_bin(cmos_read(0x09));
+    terminal_printf("%02u/%02u/%u %02u:%02u:%02u\n", day, month, year + 2000, hour, minute, second);
 }
 
 void execute_time() {
-    uint8_t hour = cmos_read(0x04);
-    uint8_t minute = cmos_read(0x02);
-    uint8_t second = cmos_read(0x00);
-    hour = bcd_to_bin(hour);
-    minute = bcd_to_bin(minute);
-    second = bcd_to_bin(second);
-    char hour_str[3], min_str[3], sec_str[3];
-    int_to_str(hour, hour_str);
-    int_to_str(minute, min_str);
-    int_to_str(second, sec_str);
-    terminal_writestring("");
-    terminal_writestring(hour_str);
-    terminal_writestring(":");
-    terminal_writestring(min_str);
-    terminal_writestring(":");
-    terminal_writestring(sec_str);
-    terminal_writestring("\n");
+    uint8_t hour = bcd_to_bin(cmos_read(0x04));
+    uint8_t minute = bcd_to_bin(cmos_read(0x02));
+    uint8_t second = bcd_to_bin(cmos_read(0x00));
+    terminal_printf("%02u:%02u:%02u\n", hour, minute, second);
 }
 
 void execute_whoami() {
@@ -239,11 +57,7 @@ void execute_whoami() {
 
 void execute_uptime() {
     uint32_t seconds = timer_ticks / TIMER_HZ;
-    char sec_str[16];
-    terminal_writestring("");
-    terminal_writestring(sec_str);
-    terminal_writestring(" seconds\n");
-    terminal_printf("Uptime: seconds\n");
+    terminal_printf("Uptime: %u seconds\n", seconds);
 }
 
 void execute_ver() {
@@ -263,48 +77,26 @@ void execute_cls() {
 
 void execute_exit() {
     terminal_writestring("Welcome to Srunix86\n");
-    ttys[current_tty].logged_in = false;
+    terminal_tty->logged_in = false;
     login_screen();
 }
 
 void execute_memory() {
     uint32_t used_memory_kb = (next_node_addr - 0x100000) / 1024;
-    uint32_t free_memory_kb = TOTAL_MEMORY_KB - used_memory_kb;
-    char used_str[16], free_str[16], total_str[16];
-    int_to_str(used_memory_kb, used_str);
-    int_to_str(free_memory_kb, free_str);
-    int_to_str(TOTAL_MEMORY_KB, total_str);
-    terminal_writestring("");
-    terminal_writestring("total: ");
-    terminal_writestring(total_str);
-    terminal_writestring(" KB\n");
-    terminal_writestring("used:  ");
-    terminal_writestring(used_str);
-    terminal_writestring(" KB\n");
-    terminal_writestring("free:  ");
-    terminal_writestring(free_str);
-    terminal_writestring(" KB\n");
+    uint32_t free_memory_kb = total_memory_kb - used_memory_kb;
+    terminal_printf("total: %8u KB\n", total_memory_kb);
+    terminal_printf("used:  %8u KB\n", used_memory_kb);
+    terminal_printf("free:  %8u KB\n", free_memory_kb);
 }
 
 void execute_disk() {
-    terminal_writestring("");
     terminal_writestring(" \n");
     for (int i = 0; i < disk_count; i++) {
-        char total_str[16], used_str[16], free_str[16];
-        int_to_str(disks[i].total_bytes / (1024 * 1024), total_str);
-        int_to_str((disks[i].total_bytes - disks[i].free_bytes) / (1024 * 1024), used_str);
-        int_to_str(disks[i].free_bytes / (1024 * 1024), free_str);
-        terminal_writestring(disks[i].name);
-        terminal_writestring(":");
-        terminal_writestring("  Total: ");
-        terminal_writestring(total_str);
-        terminal_writestring(" MB\n");
-        terminal_writestring("  Used:  ");
-        terminal_writestring(used_str);
-        terminal_writestring(" MB\n");
-        terminal_writestring("  Free:  ");
-        terminal_writestring(free_str);
-        terminal_writestring(" MB\n");
+        terminal_printf("%s:\n", disks[i].name);
+        terminal_printf("  Total: %6llu MB\n", (unsigned long long)disks[i].total_bytes / (1024 * 1024));
+        terminal_printf("  Used:  %6llu MB\n",
+                      (unsigned long long)(disks[i].total_bytes - disks[i].free_bytes) / (1024 * 1024));
+        terminal_printf("  Free:  %6llu MB\n", (unsigned long long)disks[i].free_bytes / (1024 * 1024));
         if (i < disk_count - 1) {
             terminal_writestring("\n");
         }
@@ -320,7 +112,7 @@ void execute_beep() {
 void execute_sysinfo() {
     terminal_writestring("System Info:\n");
     uint32_t used_memory_kb = (next_node_addr - 0x100000) / 1024;
-    uint32_t free_memory_kb = TOTAL_MEMORY_KB - used_memory_kb;
+    uint32_t free_memory_kb = total_memory_kb - used_memory_kb;
     char used_str[16], free_str[16], total_str[16];
     int_to_str(used_memory_kb, used_str);
     int_to_str(free_memory_kb, total_str);
@@ -365,12 +157,20 @@ void get_cpu_name(char* buffer) {
 }
 
 void get_memory_info(uint32_t* total_kb, uint32_t* used_kb) {
-    *total_kb = TOTAL_MEMORY_KB;
+    *total_kb = total_memory_kb;
     *used_kb = (next_node_addr - 0x100000) / 1024;
 }
 
 void get_resolution(char* buffer) {
-    strcpy(buffer, "1920x1080");
+    if (!fb_console) {
+        strcpy(buffer, "720x400 (text)");
+        return;
+    }
+    char num[16];
+    int_to_str(fb_width, buffer);
+    strcat(buffer, "x");
+    int_to_str(fb_height, num);
+    strcat(buffer, num);
 }
 
 void execute_fetch() {
@@ -425,7 +225,7 @@ void execute_fetch() {
     terminal_setcolor(COLOR_WHITE, COLOR_BLACK);
     terminal_writestring("/dev/tty");
     char tty_num[4];
-    int_to_str(current_tty + 1, tty_num);
+    int_to_str(terminal_tty_index() + 1, tty_num);
     terminal_writestring(tty_num);
     terminal_writestring("\n");
     terminal_setcolor(COLOR_YELLOW, COLOR_BLACK);
@@ -482,30 +282,31 @@ void execute_mkdir(char* dirname) {
 }
 
 void execute_rm(char* name, bool recursive) {
-    for (int i = 0; i < file_count; i++) {
-        if (files[i].parent_inode == current_inode && strcmp(files[i].name, name) == 0) {
-            if (files[i].type == FILE_DIR && !recursive) {
-                terminal_writestring("Cannot remove directory: use 'rm -rf' for directories\n");
-                return;
-            }
-            if (files[i].type == FILE_DIR && recursive) {
-                uint32_t dir_inode = files[i].inode;
-                for (int j = 0; j < file_count; j++) {
-                    if (files[j].parent_inode == dir_inode) {
-                        execute_rm(files[j].name, true);
-                        j--;
-                    }
-                }
-            }
-            if (fs_delete_file(files[i].inode) == FS_SUCCESS) {
-                terminal_printf("'%s' deleted\n", name);
-            } else {
-                terminal_writestring("Failed to delete\n");
+    int i = fs_lookup(current_inode, name);
+    if (i == -1) {
+        terminal_printf("File not found: %s\n", name);
+        return;
+    }
+    if (files[i].type == FILE_DIR && !recursive) {
+        terminal_writestring("Cannot remove directory: use 'rm -rf' for directories\n");
+        return;
+    }
+    uint32_t inode = files[i].inode;
+    if (files[i].type == FILE_DIR) {
+        uint32_t saved_inode = current_inode;
+        current_inode = inode;
+        for (int j = file_count - 1; j >= 0; j--) {
+            if (j < file_count && files[j].parent_inode == inode) {
+                execute_rm(files[j].name, true);
             }
-            return;
         }
+        current_inode = saved_inode;
+    }
+    if (fs_delete_file(inode) == FS_SUCCESS) {
+        terminal_printf("'%s' deleted\n", name);
+    } else {
+        terminal_writestring("Failed to delete\n");
     }
-    terminal_printf("File not found: %s\n", name);
 }
 
 void execute_ps() {
@@ -522,24 +323,79 @@ void execute_ps() {
 }
 
 void execute_jobs() {
-    for (int i = 0; i < process_count; i++) {
-        if (processes[i].pgid == processes[i].pid) {
-            terminal_printf("[%d] %s %s\n", 
-                          i, 
-                          processes[i].state == 1 ? "Stopped" : "Running",
-                          processes[i].name);
-        }
+    for (int i = 0; i < MAX_JOBS; i++) {
+        Job* job = &jobs[i];
+        if (!job->used || job->tty != terminal_tty_index()) continue;
+        terminal_printf("[%d] %s\t%s%s\n",
+                      job->id,
+                      job_stopped(job) ? "Stopped" : job_running(job) ? "Running" : "Done",
+                      job->cmd,
+                      job->background ? " &" : "");
     }
 }
 
+static Job* job_spec(const char* spec) {
+    if (spec != NULL && *spec == '%') spec++;
+    return job_get(terminal_tty_index(), spec != NULL ? atoi(spec) : 0);
+}
+
 void execute_kill(char* pid_str, char* sig_str) {
-    uint32_t pid = atoi(pid_str);
     uint32_t sig = atoi(sig_str);
+    if (pid_str[0] == '%') {
+        Job* job = job_spec(pid_str);
+        if (job == NULL) {
+            terminal_printf("kill: %s: no such job\n", pid_str);
+            return;
+        }
+        signal_group(job->pgid, sig);
+        return;
+    }
+    uint32_t pid = atoi(pid_str);
     send_signal(pid, sig);
 }
 
-void klog(int level, const char* message) {
-    char* levels[] = {"DEBUG", "INFO", "WARN", "ERROR"};
+void execute_fg(char* spec) {
+    Job* job = job_spec(spec);
+    if (job == NULL) {
+        terminal_writestring("fg: no such job\n");
+        return;
+    }
+    terminal_printf("%s\n", job->cmd);
+    job->background = false;
+    signal_group(job->pgid, SIGCONT);
+    job_wait(job);
+}
+
+void execute_bg(char* spec) {
+    Job* job = job_spec(spec);
+    if (job == NULL) {
+        terminal_writestring("bg: no such job\n");
+        return;
+    }
+    job->background = true;
+    signal_group(job->pgid, SIGCONT);
+    terminal_printf("[%d] %s &\n", job->id, job->cmd);
+}
+
+void execute_wait(char* spec) {
+    Job* only = NULL;
+    if (spec != NULL && (only = job_spec(spec)) == NULL) {
+        terminal_writestring("wait: no such job\n");
+        return;
+    }
+    terminal_tty->interrupted = false;
+    while (!terminal_tty->interrupted) {
+        bool busy = false;
+        for (int i = 0; i < MAX_JOBS; i++) {
+            Job* job = &jobs[i];
+            if (!job->used || job->tty != terminal_tty_index() || (only != NULL && job != only)) continue;
+            if (job->pgid == processes[current_process].pgid) continue;
+            if (job_running(job) && !job_stopped(job)) busy = true;
+        }
+        if (!busy) break;
+        keyboard_typeahead();
+        task_yield();
+    }
 }
 
 uint32_t sys_fork() {
@@ -547,8 +403,10 @@ uint32_t sys_fork() {
     Process* parent = &processes[current_process];
     Process* child = &processes[process_count++];
     memcpy(child, parent, sizeof(Process));
-    child->pid = process_count + 1;
+    child->pid = next_pid++;
     child->ppid = parent->pid;
+    child->stack = NULL;
+    child->stack_ptr = 0;
     return child->pid;
 }
 
@@ -557,22 +415,35 @@ void sys_exit(uint32_t status) {
     processes[current_process].exit_code = status;
 }
 
+static void task_close_pipes(int i) {
+    Stream* out = i == current_process ? terminal_out : processes[i].out;
+    Pipe* in = i == current_process ? terminal_in : processes[i].in;
+    if (out != NULL && out->write == pipe_sink) pipe_close(out->ctx);
+    if (in != NULL) in->broken = true;
+}
+
 void send_signal(uint32_t pid, uint32_t sig) {
     for (int i = 0; i < process_count; i++) {
         if (processes[i].pid == pid) {
             switch(sig) {
                 case SIGINT:
                 case SIGKILL:
+                    if (processes[i].stack != NULL) {
+                        task_close_pipes(i);
+                        processes[i].state = PROC_ZOMBIE;
+                        break;
+                    }
                     for (int j = i; j < process_count - 1; j++) {
                         processes[j] = processes[j + 1];
                     }
                     process_count--;
+                    if (i < current_process) current_process--;
                     break;
                 case SIGSTOP:
-                    processes[i].state = 1;
+                    if (processes[i].state == PROC_RUNNING) processes[i].state = PROC_STOPPED;
                     break;
                 case SIGCONT:
-                    processes[i].state = 0;
+                    if (processes[i].state == PROC_STOPPED) processes[i].state = PROC_RUNNING;
                     break;
             }
             return;
@@ -581,15 +452,271 @@ void send_signal(uint32_t pid, uint32_t sig) {
     terminal_printf("Process %d not found\n", pid);
 }
 
-void execute_command(char* cmd) {
+void signal_group(uint32_t pgid, uint32_t sig) {
+    for (int i = process_count - 1; i >= 0; i--) {
+        if (i < process_count && processes[i].pgid == pgid) send_signal(processes[i].pid, sig);
+    }
+}
+
+static void cmd_help(char** args, int arg_count) {
+    execute_help(arg_count > 1 ? atoi(args[1]) : 1);
+}
+
+BUILTIN_CALL(cmd_cls, execute_cls)
+BUILTIN_CALL(cmd_ver, execute_ver)
+BUILTIN_CALL(cmd_ls, execute_ls)
+BUILTIN_CALL(cmd_pwd, execute_pwd)
+
+static void cmd_cd(char** args, int arg_count) {
+    execute_cd(arg_count > 1 ? args[1] : NULL);
+}
+
+static void cmd_cat(char** args, int arg_count) {
+    execute_cat(arg_count > 1 ? args[1] : NULL);
+}
+
+BUILTIN_CALL(cmd_date, execute_date)
+BUILTIN_CALL(cmd_time, execute_time)
+BUILTIN_CALL(cmd_whoami, execute_whoami)
+BUILTIN_CALL(cmd_uptime, execute_uptime)
+
+static void cmd_sh(char** args, int arg_count) {
+    if (arg_count > 1) {
+        execute_script(args[1]);
+        return;
+    }
+    shell();
+}
+
+BUILTIN_CALL(cmd_mem, execute_memory)
+BUILTIN_CALL(cmd_lsblk, execute_disk)
+BUILTIN_CALL(cmd_pause, execute_pause)
+BUILTIN_CALL(cmd_poweroff, execute_poweroff)
+
+static void cmd_kptest(char** args, int arg_count) {
+    (void)args;
+    (void)arg_count;
+    kernel_panic("CRITICAL: error!\nSystem is crashed\nKernel panic - not syncing: Attempted to kill init!");
+}
+
+BUILTIN_CALL(cmd_reboot, execute_reboot)
+BUILTIN_CALL(cmd_exit, execute_exit)
+
+static void cmd_info(char** args, int arg_count) {
+    (void)args;
+    (void)arg_count;
+    terminal_setcolor(COLOR_WHITE, COLOR_BLACK);
+    info_program_run();
+}
+
+static void cmd_dhcpcd(char** args, int arg_count) {
+    (void)arg_count;
+    execute_dhcpcd(args[1]);
+}
+
+BUILTIN_CALL(cmd_ifconfig, execute_ifconfig)
+
+static void cmd_ping(char** args, int arg_count) {
+    (void)arg_count;
+    execute_ping(args[1]);
+}
+
+static void cmd_touch(char** args, int arg_count) {
+    (void)arg_count;
+    execute_mkfile(args[1]);
+}
+
+BUILTIN_CALL(cmd_fetch, execute_fetch)
+
+static void cmd_mkdir(char** args, int arg_count) {
+    (void)arg_count;
+    execute_mkdir(args[1]);
+}
+
+static void cmd_rm(char** args, int arg_count) {
+    if (strcmp(args[1], "-rf") == 0) {
+        if (arg_count > 2) execute_rm(args[2], true);
+        else terminal_writestring("Usage: rm <filename> or rm -rf <dirname>\n");
+    } else {
+        execute_rm(args[1], false);
+    }
+}
+
+BUILTIN_CALL(cmd_beep, execute_beep)
+BUILTIN_CALL(cmd_z, zv)
+BUILTIN_CALL(cmd_ps, execute_ps)
+BUILTIN_CALL(cmd_jobs, execute_jobs)
+
+static void cmd_kill(char** args, int arg_count) {
+    (void)arg_count;
+    execute_kill(args[1], args[2]);
+}
+
+static void cmd_fg(char** args, int arg_count) {
+    (void)arg_count;
+    execute_fg(args[1]);
+}
+
+static void cmd_bg(char** args, int arg_count) {
+    (void)arg_count;
+    execute_bg(args[1]);
+}
+
+static void cmd_wait(char** args, int arg_count) {
+    (void)arg_count;
+    execute_wait(args[1]);
+}
+
+BUILTIN_CALL(cmd_smouse, execute_smouse)
+
+static void cmd_chattr(char** args, int arg_count) {
+    (void)arg_count;
+    execute_chattr(args[1], args[2]);
+}
+
+static void cmd_dedup(char** args, int arg_count) {
+    execute_dedup(arg_count > 1 ? args[1] : NULL);
+}
+
+static void cmd_bench(char** args, int arg_count) {
+    execute_bench(arg_count > 1 ? args[1] : NULL, arg_count > 2 ? args[2] : NULL);
+}
+
+static void cmd_truncate(char** args, int arg_count) {
+    (void)arg_count;
+    execute_truncate(args[1], args[2], args[3]);
+}
+
+static void cmd_fallocate(char** args, int arg_count) {
+    (void)arg_count;
+    execute_fallocate(args[1], args[2], args[3]);
+}
+
+static void cmd_serial(char** args, int arg_count) {
+    execute_serial(arg_count > 1 ? args[1] : NULL, arg_count > 2 ? args[2] : NULL);
+}
+
+const Builtin builtins[] = {
+    {"./fetch", cmd_fetch, 0, NULL, NULL, 0},
+    {"beep", cmd_beep, 0, NULL, "Play test sound", 0},
+    {"bench", cmd_bench, 0, NULL, "Run a kernel benchmark", 0},
+    {"bg", cmd_bg, 0, NULL, "Resume a job in the background [%job]", BUILTIN_SHELL},
+    {"cat", cmd_cat, 0, NULL, "Display file contents", 0},
+    {"cd", cmd_cd, 0, NULL, "Change directory", BUILTIN_SHELL},
+    {"chattr", cmd_chattr, 2, "chattr +c|-c <filename>", "Change file attributes (+c/-c compression)", 0},
+    {"clear", cmd_cls, 0, NULL, NULL, 0},
+    {"cls", cmd_cls, 0, NULL, "Clear screen", 0},
+    {"date", cmd_date, 0, NULL, "Show current date/time", 0},
+    {"dedup", cmd_dedup, 0, NULL, "Block deduplication [on|off] and stats", 0},
+    {"dhcpcd", cmd_dhcpcd, 1, "dhcpcd <interface>", "Automatically configures the fake Internet", 0},
+    {"dmesg", execute_dmesg, 0, NULL, "Kernel log [-l level] [-c] [-s on|off]", 0},
+    {"echo", execute_echo, 0, NULL, "Display message", 0},
+    {"exit", cmd_exit, 0, NULL, "Log out", BUILTIN_SHELL},
+    {"fallocate", cmd_fallocate, 3, "fallocate -l <size> <filename>", "Preallocate file blocks (-l <size>)", 0},
+    {"fetch", cmd_fetch, 0, NULL, "Show system information", 0},
+    {"fg", cmd_fg, 0, NULL, "Bring a job to the foreground [%job]", BUILTIN_SHELL},
+    {"grep", execute_grep, 0, NULL, "Search files [-c] [-n] <pattern> <file>...", 0},
+    {"help", cmd_help, 0, NULL, "Show help [page]", 0},
+    {"history", execute_history, 0, NULL, "Command history [-c] [-w file] [-r file]", 0},
+    {"ifconfig", cmd_ifconfig, 0, NULL, "Show network interfaces", 0},
+    {"info", cmd_info, 0, NULL, "System information viewer", 0},
+    {"jobs", cmd_jobs, 0, NULL, "List jobs", BUILTIN_SHELL},
+    {"kill", cmd_kill, 2, "kill <pid>|%<job> <signal>", "Send a signal to a process or job", BUILTIN_SHELL},
+    {"kptest", cmd_kptest, 0, NULL, "Test Kernel Panic", 0},
+    {"ls", cmd_ls, 0, NULL, "List files", 0},
+    {"lsblk", cmd_lsblk, 0, NULL, "Show disk information", 0},
+    {"mem", cmd_mem, 0, NULL, "Show memory usage", 0},
+    {"memory", cmd_mem, 0, NULL, NULL, 0},
+    {"mkdir", cmd_mkdir, 1, "mkdir <dirname>", "Create directory", 0},
+    {"neofetch", cmd_fetch, 0, NULL, NULL, 0},
+    {"pause", cmd_pause, 0, NULL, "Wait for keypress", 0},
+    {"ping", cmd_ping, 1, "ping <host>", "Emulator for sending packets to the server", 0},
+    {"poweroff", cmd_poweroff, 0, NULL, "Shut down", 0},
+    {"ps", cmd_ps, 0, NULL, "List processes", 0},
+    {"pwd", cmd_pwd, 0, NULL, "Print working directory", 0},
+    {"reboot", cmd_reboot, 0, NULL, "Reboot", 0},
+    {"restart", cmd_reboot, 0, NULL, NULL, 0},
+    {"rm", cmd_rm, 1, "rm <filename> or rm -rf <dirname>", "Delete file (use -rf for directories)", 0},
+    {"serial", cmd_serial, 0, NULL, "COM1 console [mirror|redirect|off] [tty]", 0},
+    {"sh", cmd_sh, 0, NULL, "Run a script [file] or restart the shell", BUILTIN_BARE},
+    {"shutdown", cmd_poweroff, 0, NULL, NULL, 0},
+    {"smouse", cmd_smouse, 0, NULL, "Test a mouse support", BUILTIN_SHELL},
+    {"srunix64", cmd_sh, 0, NULL, NULL, BUILTIN_BARE},
+    {"time", cmd_time, 0, NULL, "Show current time", 0},
+    {"touch", cmd_touch, 1, "touch <filename>", "Create file", 0},
+    {"truncate", cmd_truncate, 3, "truncate -s <size> <filename>", "Set file size (-s <size>), sparse", 0},
+    {"uptime", cmd_uptime, 0, NULL, "Show time since boot", 0},
+    {"ver", cmd_ver, 0, NULL, "Show version", 0},
+    {"wait", cmd_wait, 0, NULL, "Wait for background jobs [%job]", BUILTIN_SHELL},
+    {"wc", execute_wc, 0, NULL, "Count lines, words and bytes [file]", 0},
+    {"whoami", cmd_whoami, 0, NULL, "Show current user", 0},
+    {"z", cmd_z, 0, NULL, "Text editor", 0},
+};
+const size_t builtin_count = sizeof(builtins) / sizeof(builtins[0]);
+
+const Builtin* builtin_find(const char* name) {
+    size_t lo = 0, hi = builtin_count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        int c = strcmp_case_insensitive(name, builtins[mid].name);
+        if (c == 0) return &builtins[mid];
+        if (c < 0) hi = mid;
+        else lo = mid + 1;
+    }
+    return NULL;
+}
+
+bool builtins_sorted() {
+    for (size_t i = 1; i < builtin_count; i++) {
+        if (strcmp_case_insensitive(builtins[i - 1].name, builtins[i].name) >= 0) return false;
+    }
+    return true;
+}
+
+static void file_sink(void* ctx, const char* data, size_t size) {
+    fs_writer_write(ctx, data, size);
+}
+
+static void run_redirected(const Builtin* b, char** args, int arg_count, const char* filename, bool append) {
+    int i = fs_lookup(current_inode, filename);
+    if (i == -1) {
+        if (fs_create_file(filename, current_inode, FILE_REGULAR) != FS_SUCCESS) return;
+        i = fs_lookup(current_inode, filename);
+    }
+    if (files[i].type != FILE_REGULAR) {
+        terminal_printf("%s: Not a regular file\n", filename);
+        return;
+    }
+    BkfsWriter w;
+    if (fs_writer_open(&w, files[i].inode, append) != FS_SUCCESS) {
+        terminal_printf("%s: Cannot open file\n", filename);
+        return;
+    }
+    Stream out = {file_sink, &w};
+    Stream* saved = terminal_out;
+    terminal_out = &out;
+    b->run(args, arg_count);
+    terminal_out = saved;
+    if (fs_writer_close(&w) != FS_SUCCESS) {
+        terminal_printf("%s: File too large or disk full\n", filename);
+    }
+}
+
+typedef struct {
+    char text[MAX_CMD_LEN];
     char* args[10];
+    int arg_count;
+    const Builtin* builtin;
+    char* redirect;
+    bool append;
+} CommandLine;
+
+static bool command_parse(CommandLine* line, const char* cmd) {
+    strncpy(line->text, cmd, MAX_CMD_LEN - 1);
+    line->text[MAX_CMD_LEN - 1] = '\0';
+    char** args = line->args;
     int arg_count = 0;
-    char cmd_copy[MAX_CMD_LEN];
-    strcpy(cmd_copy, cmd);
-    for (char* p = cmd_copy; *p; p++) {
-        if (*p >= 'A' && *p <= 'Z') *p += 32;
-    }
-    char* token = cmd_copy;
+    char* token = line->text;
     while (*token && arg_count < 10 - 1) {
         while (*token == ' ') token++;
         if (*token == '\0') break;
@@ -598,163 +725,211 @@ void execute_command(char* cmd) {
         if (*token) *token++ = '\0';
     }
     args[arg_count] = 0;
-    if (arg_count == 0) return;
-    int redirect_pos = -1;
-    int redirect_type = 0;
+    line->redirect = NULL;
+    line->append = false;
     for (int i = 1; i < arg_count; i++) {
-        if (strcmp(args[i], ">") == 0) {
-            redirect_pos = i;
-            redirect_type = 1;
-            break;
-        } else if (strcmp(args[i], ">>") == 0) {
-            redirect_pos = i;
-            redirect_type = 2;
+        if (strcmp(args[i], ">") == 0 || strcmp(args[i], ">>") == 0) {
+            if (i + 1 >= arg_count) {
+                terminal_writestring("Syntax error near '>'\n");
+                return false;
+            }
+            line->append = args[i][1] == '>';
+            line->redirect = args[i + 1];
+            args[i] = 0;
+            arg_count = i;
             break;
         }
     }
-    if (redirect_pos != -1 && redirect_pos < arg_count - 1) {
-        if (strcmp_case_insensitive(args[0], "echo") == 0) {
-            char text[MAX_CMD_LEN] = {0};
-            for (int i = 1; i < redirect_pos; i++) {
-                if (i > 1) strcat(text, " ");
-                strcat(text, args[i]);
-            }
-            if (redirect_type == 1) {
-                execute_redirect_output(args[redirect_pos + 1], text);
-            } else if (redirect_type == 2) {
-                execute_append_output(args[redirect_pos + 1], text);
-            }
+    line->arg_count = arg_count;
+    line->builtin = arg_count > 0 ? builtin_find(args[0]) : NULL;
+    return true;
+}
+
+static void command_run(CommandLine* line) {
+    if (line->arg_count == 0) return;
+    const Builtin* b = line->builtin;
+    if (b == NULL) {
+        terminal_printf("Command not found: %s\nType 'help' for commands\n", line->args[0]);
+        return;
+    }
+    if (line->arg_count - 1 < b->min_args) {
+        terminal_printf("Usage: %s\n", b->usage);
+        return;
+    }
+    if (line->redirect != NULL) {
+        run_redirected(b, line->args, line->arg_count, line->redirect, line->append);
+        return;
+    }
+    b->run(line->args, line->arg_count);
+}
+
+static void run_command_line(char* cmd) {
+    CommandLine line;
+    if (command_parse(&line, cmd)) command_run(&line);
+}
+
+typedef struct {
+    char cmd[MAX_CMD_LEN];
+    Pipe* in;
+    Stream out;
+    int pid;
+} PipelineStage;
+
+static void pipeline_stage() {
+    PipelineStage* st = processes[current_process].arg;
+    terminal_in = st->in;
+    terminal_out = &st->out;
+    run_command_line(st->cmd);
+    pipe_close(st->out.ctx);
+    if (st->in != NULL) st->in->broken = true;
+    terminal_out = NULL;
+    terminal_in = NULL;
+}
+
+static void execute_pipeline(char* cmd) {
+    PipelineStage stages[MAX_PIPES + 1];
+    Pipe* links[MAX_PIPES];
+    int n = 0;
+    char* part = cmd;
+    while (part != NULL) {
+        char* bar = strchr(part, '|');
+        if (bar != NULL) *bar = '\0';
+        char* p = part;
+        while (*p == ' ') p++;
+        if (*p == '\0') {
+            terminal_writestring("Syntax error near '|'\n");
             return;
-        } 
-        else if (strcmp_case_insensitive(args[0], "cat") == 0) {
-            if (redirect_pos == 1 && arg_count == 3) {
-                bool append = (redirect_type == 2);
-                execute_cat_redirect(args[1], args[2], append);
-            } else {
-                terminal_writestring("Usage: cat <source_file> > <dest_file> or cat <source_file> >> <dest_file>\n");
-            }
+        }
+        if (n == MAX_PIPES + 1) {
+            terminal_writestring("Pipeline too long\n");
             return;
         }
+        strcpy(stages[n++].cmd, p);
+        part = bar != NULL ? bar + 1 : NULL;
     }
-    if (strcmp_case_insensitive(args[0], "help") == 0) {
-        int page = 1;
-        if (arg_count > 1) {
-            page = atoi(args[1]);
-        }
-        execute_help(page);
-    } else if (strcmp_case_insensitive(args[0], "cls") == 0 || 
-               strcmp_case_insensitive(args[0], "clear") == 0) {
-        execute_cls();
-    } else if (strcmp_case_insensitive(args[0], "ver") == 0) {
-        execute_ver();
-    } else if (strcmp_case_insensitive(args[0], "ls") == 0) {
-        execute_ls();
-    } else if (strcmp_case_insensitive(args[0], "pwd") == 0) {
-        execute_pwd();
-    } else if (strcmp_case_insensitive(args[0], "cd") == 0) {
-        if (arg_count > 1) execute_cd(args[1]);
-        else execute_cd(NULL);
-    } else if (strcmp_case_insensitive(args[0], "echo") == 0) {
-        char* orig_args[10];
-        int orig_arg_count = 0;
-        char* orig_token = cmd;
-        while (*orig_token && orig_arg_count < 10 - 1) {
-            while (*orig_token == ' ') orig_token++;
-            if (*orig_token == '\0') break;
-            orig_args[orig_arg_count++] = orig_token;
-            while (*orig_token && *orig_token != ' ') orig_token++;
-            if (*orig_token) *orig_token++ = '\0';
-        }
-        orig_args[orig_arg_count] = 0;
-        execute_echo(orig_args, orig_arg_count);
-    } else if (strcmp_case_insensitive(args[0], "cat") == 0) {
-        if (arg_count > 1) execute_cat(args[1]);
-        else terminal_writestring("Usage: cat <filename>\n");
-    } else if (strcmp_case_insensitive(args[0], "date") == 0) {
-        execute_date();
-    } else if (strcmp_case_insensitive(args[0], "time") == 0) {
-        execute_time();
-    } else if (strcmp_case_insensitive(args[0], "whoami") == 0) {
-        execute_whoami();
-    } else if (strcmp_case_insensitive(args[0], "uptime") == 0) {
-        execute_uptime();
-    } else if (strcmp_case_insensitive(args[0], "sh") == 0 ||
-	       strcmp_case_insensitive(args[0], "srunix64") == 0 ) {
-	    shell();
-    } else if (strcmp_case_insensitive(args[0], "mem") == 0 || 
-               strcmp_case_insensitive(args[0], "memory") == 0) {
-        execute_memory();
-    } else if (strcmp_case_insensitive(args[0], "lsblk") == 0) {
-        execute_disk();
-    } else if (strcmp_case_insensitive(args[0], "pause") == 0) {
-        execute_pause();
-    } else if (strcmp_case_insensitive(args[0], "poweroff") == 0 || 
-               strcmp_case_insensitive(args[0], "shutdown") == 0) {
-        execute_poweroff();
-    } else if (strcmp_case_insensitive(args[0], "kptest") == 0) {
-        kernel_panic("CRITICAL: error!\nSystem is crashed\nKernel panic - not syncing: Attempted to kill init!");
-    } else if (strcmp_case_insensitive(args[0], "reboot") == 0 || 
-               strcmp_case_insensitive(args[0], "restart") == 0) {
-        execute_reboot();
-    } else if (strcmp_case_insensitive(args[0], "exit") == 0) {
-        execute_exit();
-    } else if (strcmp_case_insensitive(args[0], "info") == 0) {
-        terminal_setcolor(COLOR_WHITE, COLOR_BLACK);
-        info_program_run();
-    } else if (strcmp_case_insensitive(args[0], "dhcpcd") == 0) {
-        if (arg_count > 1) execute_dhcpcd(args[1]);
-        else terminal_writestring("Usage: dhcpcd <interface>\n");
-    } else if (strcmp_case_insensitive(args[0], "ifconfig") == 0) {
-        execute_ifconfig();
-    } else if (strcmp_case_insensitive(args[0], "ping") == 0) {
-        if (arg_count > 1) execute_ping(args[1]);
-        else terminal_writestring("Usage: ping <host>\n");
-    } else if (strcmp_case_insensitive(args[0], "touch") == 0) {
-        if (arg_count > 1) execute_mkfile(args[1]);
-        else terminal_writestring("Usage: touch <filename>\n");
-    } else if (strcmp_case_insensitive(args[0], "fetch") == 0 ||
-               strcmp_case_insensitive(args[0], "neofetch") == 0 ||
-               strcmp_case_insensitive(args[0], "./fetch") == 0) {
-        execute_fetch();
-    } else if (strcmp_case_insensitive(args[0], "mkdir") == 0) {
-        if (arg_count > 1) execute_mkdir(args[1]);
-        else terminal_writestring("Usage: mkdir <dirname>\n");
-    } else if (strcmp_case_insensitive(args[0], "rm") == 0) {
-        bool recursive = false;
-        char* filename = NULL;
-        if (arg_count > 1) {
-            if (strcmp(args[1], "-rf") == 0) {
-                recursive = true;
-                if (arg_count > 2) {
-                    filename = args[2];
-                }
-            } else {
-                filename = args[1];
-            }
+    for (int i = 0; i < n - 1; i++) {
+        links[i] = pipe_alloc();
+        if (links[i] == NULL) {
+            for (int j = 0; j < i; j++) pipe_release(links[j]);
+            terminal_writestring("No free pipes\n");
+            return;
         }
-        if (filename) {
-            execute_rm(filename, recursive);
-        } else {
-            terminal_writestring("Usage: rm <filename> or rm -rf <dirname>\n");
+    }
+    for (int i = 0; i < n - 1; i++) {
+        PipelineStage* st = &stages[i];
+        st->in = i > 0 ? links[i - 1] : NULL;
+        st->out.write = pipe_sink;
+        st->out.ctx = links[i];
+        char name[32];
+        command_name(name, sizeof(name), st->cmd);
+        st->pid = task_create(name, pipeline_stage, terminal_tty_index(), st);
+        if (st->pid != -1) task_find(st->pid)->pgid = processes[current_process].pgid;
+        if (st->pid == -1) {
+            terminal_writestring("Cannot start pipeline stage\n");
+            pipe_close(links[i]);
+            if (st->in != NULL) st->in->broken = true;
         }
-    } else if (strcmp_case_insensitive(args[0], "beep") == 0) {
-        execute_beep();
-    } else if (strcmp_case_insensitive(args[0], "Z") == 0) {
-	    zv();
-    } else if (strcmp_case_insensitive(args[0], "ps") == 0) {
-        execute_ps();
-    } else if (strcmp_case_insensitive(args[0], "jobs") == 0) {
-        execute_jobs();
-    } else if (strcmp_case_insensitive(args[0], "kill") == 0) {
-        if (arg_count >= 3) execute_kill(args[1], args[2]);
-        else terminal_writestring("Usage: kill <pid> <signal>\n");
-    } else if (strcmp_case_insensitive(args[0], "smouse") == 0) {
-        execute_smouse();
-    } else if (args[0][0] != '\0') {
-        terminal_writestring("Command not found: ");
-        terminal_writestring(args[0]);
-        terminal_writestring("\nType 'help' for commands\n");
     }
+    Pipe* saved_in = terminal_in;
+    terminal_in = links[n - 2];
+    run_command_line(stages[n - 1].cmd);
+    links[n - 2]->broken = true;
+    terminal_in = saved_in;
+    for (int i = 0; i < n - 1; i++) {
+        if (stages[i].pid == -1) continue;
+        while (task_alive(stages[i].pid)) task_yield();
+        task_reap(stages[i].pid);
+    }
+    for (int i = 0; i < n - 1; i++) pipe_release(links[i]);
+}
+
+void execute_command(char* cmd) {
+    if (strchr(cmd, '|') != NULL) {
+        char line[MAX_CMD_LEN];
+        strcpy(line, cmd);
+        execute_pipeline(line);
+        return;
+    }
+    run_command_line(cmd);
+}
+
+static bool shell_inline(const char* line) {
+    if (strchr(line, '|') != NULL) return false;
+    char name[32];
+    command_name(name, sizeof(name), line);
+    const Builtin* b = builtin_find(name);
+    if (b != NULL && (b->flags & BUILTIN_BARE)) {
+        const char* rest = line + strlen(name);
+        while (*rest == ' ') rest++;
+        return *rest == '\0';
+    }
+    return b == NULL || (b->flags & BUILTIN_SHELL);
+}
+
+void shell_run(char* line) {
+    size_t len = strlen(line);
+    while (len > 0 && line[len - 1] == ' ') line[--len] = '\0';
+    bool background = len > 0 && line[len - 1] == '&';
+    if (background) line[--len] = '\0';
+    while (len > 0 && line[len - 1] == ' ') line[--len] = '\0';
+    while (*line == ' ') line++;
+    if (*line == '\0') return;
+    if (!background && shell_inline(line)) {
+        execute_command(line);
+        return;
+    }
+    Job* job = job_spawn(line, background);
+    if (job == NULL) {
+        terminal_writestring("Cannot start job\n");
+        return;
+    }
+    if (background) terminal_printf("[%d] %u\n", job->id, job->pgid);
+    else job_wait(job);
+}
+
+static void script_line(void* ctx, char* text, uint32_t line_no) {
+    const char* path = ctx;
+    if (text == NULL) {
+        terminal_printf("sh: %s:%u: Line too long\n", path, line_no);
+        return;
+    }
+    while (*text == ' ') text++;
+    if (*text == '\0' || *text == '#') return;
+    size_t len = strlen(text);
+    while (len > 0 && (text[len - 1] == ' ' || text[len - 1] == '\r')) text[--len] = '\0';
+    if (len == 0) return;
+    if (text[len - 1] == '&') {
+        shell_run(text);
+        return;
+    }
+    if (strchr(text, '|') != NULL) {
+        execute_command(text);
+        return;
+    }
+    CommandLine line;
+    if (!command_parse(&line, text)) {
+        terminal_printf("sh: %s:%u: bad line\n", path, line_no);
+        return;
+    }
+    command_run(&line);
+}
+
+void execute_script(const char* path) {
+    int i = fs_resolve(current_inode, path);
+    if (i == -1 || files[i].type != FILE_REGULAR) {
+        terminal_printf("sh: %s: No such file\n", path);
+        return;
+    }
+    Process* self = &processes[current_process];
+    if (self->script_depth >= SCRIPT_DEPTH_MAX) {
+        terminal_printf("sh: %s: Scripts nested too deeply\n", path);
+        return;
+    }
+    self->script_depth++;
+    uint32_t saved_inode = current_inode;
+    fs_read_lines(files[i].inode, script_line, (void*)path);
+    current_inode = saved_inode;
+    processes[current_process].script_depth--;
 }
 
 void print_prompt() {
@@ -768,17 +943,14 @@ void print_prompt() {
         char path[MAX_PATH_LEN] = {0};
         uint32_t inode = current_inode;
         while (inode != 1) { 
-            for (int i = 0; i < file_count; i++) {
-                if (files[i].inode == inode) {
-                    char temp[MAX_PATH_LEN];
-                    strcpy(temp, "/");
-                    strcat(temp, files[i].name);
-                    strcat(temp, path);
-                    strcpy(path, temp);
-                    inode = files[i].parent_inode;
-                    break;
-                }
-            }
+            int i = fs_dirent_of(inode);
+            if (i == -1) break;
+            char temp[MAX_PATH_LEN];
+            strcpy(temp, "/");
+            strcat(temp, files[i].name);
+            strcat(temp, path);
+            strcpy(path, temp);
+            inode = files[i].parent_inode;
         }
         terminal_writestring(path);
     } else {
@@ -797,7 +969,7 @@ void login_screen() {
     terminal_writestring("\n\n");
     terminal_writestring("Srunix86 tty");
     char tty_num[2];
-    int_to_str(current_tty + 1, tty_num);
+    int_to_str(terminal_tty_index() + 1, tty_num);
     terminal_writestring(tty_num);
     terminal_writestring("\n");
     terminal_setcolor(COLOR_GRAY, COLOR_BLACK);
@@ -843,11 +1015,11 @@ void login_screen() {
     if (strcmp(username, "1") == 0 && strcmp(password, "1") == 0) {
         terminal_setcolor(COLOR_GREEN, COLOR_BLACK);
         terminal_writestring("\nWelcome to Srunix86 livecd\n");
-        ttys[current_tty].logged_in = true;
+        terminal_tty->logged_in = true;
     }
     if (strcmp(username, "root") == 0 && strcmp(password, "1") == 0) {
         terminal_writestring("\nWelcome to Srunix86 livecd\n");
-        ttys[current_tty].logged_in = true;
+        terminal_tty->logged_in = true;
         shell();
     } else {
         terminal_writestring("\nlogin incorrect\n");
@@ -856,73 +1028,261 @@ void login_screen() {
     }
 }
 
-void add_to_history(const char* cmd) {
-    if (smouse_mode) return;
-    if (strlen(cmd) == 0) return;
-    if (history_count < HISTORY_SIZE) {
-        strcpy(command_history[history_count++], cmd);
-    } else {
-        for (int i = 0; i < HISTORY_SIZE-1; i++) {
-            strcpy(command_history[i], command_history[i+1]);
+typedef struct {
+    char buf[MAX_CMD_LEN];
+    int len;
+    int pos;
+} LineEdit;
+
+static void line_tail(LineEdit* e, int erase) {
+    terminal_write(e->buf + e->pos, e->len - e->pos);
+    for (int i = 0; i < erase; i++) terminal_putchar(' ');
+    terminal_cursor_back(e->len - e->pos + erase);
+}
+
+static void line_move(LineEdit* e, int to) {
+    if (to < e->pos) terminal_cursor_back(e->pos - to);
+    else terminal_write(e->buf + e->pos, to - e->pos);
+    e->pos = to;
+}
+
+static void line_insert(LineEdit* e, const char* text, int n) {
+    if (n > MAX_CMD_LEN - 1 - e->len) n = MAX_CMD_LEN - 1 - e->len;
+    if (n <= 0) return;
+    memmove(e->buf + e->pos + n, e->buf + e->pos, e->len - e->pos);
+    memcpy(e->buf + e->pos, text, n);
+    e->len += n;
+    terminal_write(e->buf + e->pos, n);
+    e->pos += n;
+    line_tail(e, 0);
+}
+
+static void line_delete(LineEdit* e, int n) {
+    if (n > e->len - e->pos) n = e->len - e->pos;
+    if (n <= 0) return;
+    memmove(e->buf + e->pos, e->buf + e->pos + n, e->len - e->pos - n);
+    e->len -= n;
+    line_tail(e, n);
+}
+
+static void line_set(LineEdit* e, const char* text) {
+    line_move(e, 0);
+    int old = e->len;
+    e->len = strlen(text);
+    if (e->len > MAX_CMD_LEN - 1) e->len = MAX_CMD_LEN - 1;
+    memcpy(e->buf, text, e->len);
+    e->pos = 0;
+    line_move(e, e->len);
+    for (int i = e->len; i < old; i++) terminal_putchar(' ');
+    if (old > e->len) terminal_cursor_back(old - e->len);
+}
+
+static char shell_search(LineEdit* e) {
+    char query[MAX_CMD_LEN];
+    char view[2 * MAX_CMD_LEN + 32];
+    size_t qlen = 0;
+    int found = -1;
+    query[0] = '\0';
+    while (1) {
+        snprintf(view, sizeof(view), "(%sreverse-i-search)`%s': %s",
+                 found < 0 && qlen > 0 ? "failed " : "", query, found >= 0 ? history_entry(found) : "");
+        line_set(e, view);
+        char c = keyboard_getchar();
+        if (c == '\x12') {
+            int k = found > 0 ? history_search(query, found - 1) : -1;
+            if (k >= 0) found = k;
+        } else if (c == '\b') {
+            if (qlen > 0) query[--qlen] = '\0';
+            found = qlen > 0 ? history_search(query, history_count - 1) : -1;
+        } else if (c >= ' ' && c != '\x7F') {
+            if (qlen < sizeof(query) - 1) {
+                query[qlen++] = c;
+                query[qlen] = '\0';
+            }
+            found = history_search(query, found >= 0 ? found : history_count - 1);
+        } else {
+            line_set(e, found >= 0 && c != '\x03' && c != '\x07' ? history_entry(found) : "");
+            return c == '\x1B' || c == '\x07' ? 0 : c;
+        }
+    }
+}
+
+typedef struct {
+    const char* prefix;
+    size_t prefix_len;
+    int count;
+    char common[MAX_CMD_LEN];
+    size_t common_len;
+    bool dir;
+    bool list;
+} Completion;
+
+static void completion_add(Completion* c, const char* name, bool dir) {
+    if (strncmp(name, c->prefix, c->prefix_len) != 0) return;
+    if (c->list) {
+        terminal_writestring(name);
+        terminal_writestring(dir ? "/  " : "  ");
+        return;
+    }
+    if (c->count++ == 0) {
+        c->common_len = strlen(name);
+        memcpy(c->common, name, c->common_len);
+        c->dir = dir;
+        return;
+    }
+    size_t k = 0;
+    while (k < c->common_len && c->common[k] == name[k]) k++;
+    c->common_len = k;
+}
+
+static size_t builtin_lower_bound(const char* prefix) {
+    size_t lo = 0, hi = builtin_count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (strcmp(builtins[mid].name, prefix) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static void complete_scan(Completion* c, bool command, uint32_t dir) {
+    if (command) {
+        for (size_t i = builtin_lower_bound(c->prefix); i < builtin_count; i++) {
+            if (strncmp(builtins[i].name, c->prefix, c->prefix_len) != 0) break;
+            completion_add(c, builtins[i].name, false);
+        }
+        return;
+    }
+    for (int i = 0; i < file_count; i++) {
+        if (files[i].parent_inode == dir) completion_add(c, files[i].name, files[i].type == FILE_DIR);
+    }
+}
+
+static void shell_complete(LineEdit* e) {
+    int start = e->pos;
+    while (start > 0 && e->buf[start - 1] != ' ' && e->buf[start - 1] != '|') start--;
+    int before = start;
+    while (before > 0 && e->buf[before - 1] == ' ') before--;
+    bool command = before == 0 || e->buf[before - 1] == '|';
+    char word[MAX_CMD_LEN];
+    int word_len = e->pos - start;
+    memcpy(word, e->buf + start, word_len);
+    word[word_len] = '\0';
+    uint32_t dir = current_inode;
+    const char* name = word;
+    char* slash = strrchr(word, '/');
+    if (!command && slash != NULL) {
+        *slash = '\0';
+        if (slash == word) {
+            dir = 1;
+        } else {
+            int i = fs_resolve(current_inode, word);
+            if (i == -1 || files[i].type != FILE_DIR) return;
+            dir = files[i].inode;
+        }
+        name = slash + 1;
+    }
+    if (command) {
+        for (char* p = word; *p; p++) {
+            if (*p >= 'A' && *p <= 'Z') *p += 32;
         }
-        strcpy(command_history[HISTORY_SIZE-1], cmd);
     }
-    history_pos = history_count;
+    Completion c;
+    c.prefix = name;
+    c.prefix_len = strlen(name);
+    c.count = 0;
+    c.common_len = 0;
+    c.dir = false;
+    c.list = false;
+    complete_scan(&c, command, dir);
+    if (c.count == 0) return;
+    if (command && memcmp(e->buf + start, c.common, c.prefix_len) != 0) {
+        line_move(e, start);
+        line_delete(e, word_len);
+        line_insert(e, c.common, c.prefix_len);
+    }
+    if (c.common_len > c.prefix_len) {
+        line_insert(e, c.common + c.prefix_len, c.common_len - c.prefix_len);
+    }
+    if (c.count == 1) {
+        line_insert(e, c.dir ? "/" : " ", 1);
+        return;
+    }
+    if (c.common_len > c.prefix_len) return;
+    line_move(e, e->len);
+    terminal_putchar('\n');
+    c.list = true;
+    complete_scan(&c, command, dir);
+    terminal_putchar('\n');
+    print_prompt();
+    terminal_write(e->buf, e->len);
 }
 
 void shell() {
     if (smouse_mode) return;
-    char cmd[MAX_CMD_LEN];
-    int pos = 0;
     terminal_setcolor(COLOR_BRIGHT_RED, COLOR_BLACK);
     terminal_writestring("\nSrunix86 tty");
     char tty_num[2];
-    int_to_str(current_tty + 1, tty_num);
+    int_to_str(terminal_tty_index() + 1, tty_num);
     terminal_writestring(tty_num);
     terminal_writestring("\n");
     terminal_setcolor(COLOR_GRAY, COLOR_BLACK);
     terminal_writestring("Type \"help\" to see all the commands in the OS.\n\n");
     terminal_setcolor(COLOR_WHITE, COLOR_BLACK);
     while (1) {
+        job_notify();
         print_prompt();
-        pos = 0;
-        while (pos < MAX_CMD_LEN - 1) {
+        LineEdit e;
+        e.len = 0;
+        e.pos = 0;
+        int hist = history_count;
+        char draft[MAX_CMD_LEN];
+        while (1) {
             char c = keyboard_getchar();
+            if (c == '\x12') c = shell_search(&e);
             if (c == '\n') {
+                line_move(&e, e.len);
                 terminal_putchar('\n');
-                cmd[pos] = '\0';
-                add_to_history(cmd);
-                execute_command(cmd);
+                e.buf[e.len] = '\0';
+                history_add(e.buf);
+                shell_run(e.buf);
+                break;
+            } else if (c == '\x03') {
+                line_move(&e, e.len);
+                terminal_writestring("^C\n");
                 break;
-            } else if (c == '\b') {
-                if (pos > 0) {
-                    pos--;
-                    terminal_putchar('\b');
+            } else if (c == '\b' || c == '\x7F') {
+                if (e.pos > 0) {
+                    line_move(&e, e.pos - 1);
+                    line_delete(&e, 1);
                 }
-            } else if (c == '\x11') {
-                if (history_pos > 0) {
-                    history_pos--;
-                    strcpy(cmd, command_history[history_pos]);
-                    pos = strlen(cmd);
-                    terminal_column = 0;
-                    for (int i = 0; i < pos; i++) {
-                        terminal_putchar(cmd[i]);
+            } else if (c == CHAR_DELETE || c == '\x04') {
+                line_delete(&e, 1);
+            } else if (c == CHAR_LEFT || c == '\x02') {
+                if (e.pos > 0) line_move(&e, e.pos - 1);
+            } else if (c == CHAR_RIGHT || c == '\x06') {
+                if (e.pos < e.len) line_move(&e, e.pos + 1);
+            } else if (c == CHAR_HOME || c == '\x01') {
+                line_move(&e, 0);
+            } else if (c == CHAR_END || c == '\x05') {
+                line_move(&e, e.len);
+            } else if (c == '\t') {
+                shell_complete(&e);
+            } else if (c == CHAR_UP) {
+                if (hist > 0) {
+                    if (hist == history_count) {
+                        e.buf[e.len] = '\0';
+                        strcpy(draft, e.buf);
                     }
+                    line_set(&e, history_entry(--hist));
                 }
-            } else if (c == '\x12') {
-                if (history_pos < history_count - 1) {
-                    history_pos++;
-                    strcpy(cmd, command_history[history_pos]);
-                    pos = strlen(cmd);
-                    terminal_column = 0;
-                    for (int i = 0; i < pos; i++) {
-                        terminal_putchar(cmd[i]);
-                    }
+            } else if (c == CHAR_DOWN) {
+                if (hist < history_count) {
+                    hist++;
+                    line_set(&e, hist == history_count ? draft : history_entry(hist));
                 }
-            } else if (c == '\x13' || c == '\x14') {
-            } else {
-                cmd[pos++] = c;
-                terminal_putchar(c);
+            } else if (c >= ' ') {
+                line_insert(&e, &c, 1);
             }
         }
     }
@@ -940,13 +1300,44 @@ void kernel_panic(const char* message) {
     terminal_writestring("\nKernel panic - not syncing: Fatal exception\n");
 }
 
-void kernel_main() {
+static void boot_rc() {
+    int rc = fs_resolve(1, "/etc/rc");
+    if (rc != -1 && files[rc].type == FILE_REGULAR) {
+        klog(LOG_LEVEL_INFO, "rc: running /etc/rc");
+        execute_script("/etc/rc");
+    }
+    login_screen();
+}
+
+void kernel_main(uintptr_t multiboot_info) {
+    mem_detect();
+    klog_init();
+    mem_init(multiboot_info);
+    klogf(LOG_LEVEL_INFO, "memory: %u KB", total_memory_kb);
+    if (fb_init(multiboot_info)) {
+        klogf(LOG_LEVEL_INFO, "fb: %ux%u, %zux%zu console", fb_width, fb_height, terminal_width, terminal_height);
+    } else {
+        klog(LOG_LEVEL_INFO, "console: vga text 80x25");
+        vga_font_capture();
+    }
     terminal_initialize();
+    if (serial_init()) {
+        serial_tty = &ttys[0];
+        serial_mode = SERIAL_MIRROR;
+        klogf(LOG_LEVEL_INFO, "serial: COM1 at %u baud, fifo %u", 115200 / SERIAL_BAUD_DIVISOR, serial_fifo_depth);
+    } else {
+        klog(LOG_LEVEL_WARN, "serial: COM1 not present");
+    }
     network_init();
-    memset(inodes, 0, sizeof(inodes));
-    memset(block_used, 0, sizeof(block_used));
-    free_blocks = MAX_BLOCKS;
-    free_inodes = MAX_INODES;
+    crc32c_init();
+    klog(LOG_LEVEL_INFO, crc32c_hw_available ? "crc32c: sse4.2" : "crc32c: table");
+    klog(LOG_LEVEL_INFO, mem_erms ? "memcpy: erms" : "memcpy: sse2");
+    if (fs_init_tables() != FS_SUCCESS) {
+        klog(LOG_LEVEL_ERROR, "bkfs: not enough memory for tables");
+        kernel_panic("bkFS: not enough memory for filesystem tables");
+        while (1) asm volatile ("hlt");
+    }
+    klogf(LOG_LEVEL_INFO, "bkfs: %u inodes, %u blocks", max_inodes, max_blocks);
     fs_create_file("root", 1, FILE_DIR);
     current_inode = 1;
     fs_create_file("bin", 1, FILE_DIR);
@@ -956,31 +1347,26 @@ void kernel_main() {
     fs_create_file("tmp", 1, FILE_DIR);
     fs_create_file("sys", 1, FILE_DIR);
     fs_create_file("fetch", 1, FILE_REGULAR);
-    uint32_t dev_inode = 0;
-    for (int i = 0; i < file_count; i++) {
-        if (strcmp(files[i].name, "dev") == 0) {
-            dev_inode = files[i].inode;
-            break;
-        }
-    }
-    if (dev_inode != 0) {
-        fs_create_file("sda", dev_inode, FILE_REGULAR);
-        fs_create_file("sda1", dev_inode, FILE_REGULAR);
-        fs_create_file("sdb1", dev_inode, FILE_REGULAR);
-        fs_create_file("sdb", dev_inode, FILE_REGULAR);
-        fs_create_file("vga", dev_inode, FILE_REGULAR);
-        fs_create_file("vga1", dev_inode, FILE_REGULAR);
-        fs_create_file("vga2", dev_inode, FILE_REGULAR);
-        fs_create_file("null", dev_inode, FILE_REGULAR);
-        fs_create_file("random", dev_inode, FILE_REGULAR);
+    int etc = fs_lookup(1, "etc");
+    if (etc != -1 && fs_create_file("rc", files[etc].inode, FILE_REGULAR) == FS_SUCCESS) {
+        const char* rc_content =
+            "# Run on tty1 at boot, before the login prompt\n"
+            "cd dev\n"
+            "touch sda\n"
+            "touch sda1\n"
+            "touch sdb1\n"
+            "touch sdb\n"
+            "touch vga\n"
+            "touch vga1\n"
+            "touch vga2\n"
+            "touch null\n"
+            "touch random\n";
+        int rc = fs_lookup(files[etc].inode, "rc");
+        if (rc != -1) fs_write_file(files[rc].inode, rc_content, strlen(rc_content));
     }
     uint32_t bin_inode = 0;
-    for (int i = 0; i < file_count; i++) {
-        if (strcmp(files[i].name, "bin") == 0) {
-            bin_inode = files[i].inode;
-            break;
-        }
-    }
+    int bin = fs_lookup(1, "bin");
+    if (bin != -1) bin_inode = files[bin].inode;
     if (bin_inode != 0) {
         fs_create_file("ush", bin_inode, FILE_REGULAR);
         fs_create_file("ls", bin_inode, FILE_REGULAR);
@@ -988,14 +1374,15 @@ void kernel_main() {
         fs_create_file("echo", bin_inode, FILE_REGULAR);
         fs_create_file("fetch", bin_inode, FILE_REGULAR);
         const char* fetch_content = "priveeet\n";
-        for (int i = 0; i < file_count; i++) {
-            if (files[i].parent_inode == bin_inode && strcmp(files[i].name, "fetch") == 0) {
-                fs_write_file(files[i].inode, fetch_content, strlen(fetch_content));
-                break;
-            }
-        }
+        int fetch = fs_lookup(bin_inode, "fetch");
+        if (fetch != -1) fs_write_file(files[fetch].inode, fetch_content, strlen(fetch_content));
     }
     init_timer();
-    login_screen();
+    for (int i = 0; i < MAX_TTYS; i++) {
+        task_create("sh", i == 0 ? boot_rc : login_screen, i, NULL);
+    }
+    klogf(LOG_LEVEL_INFO, "sched: %d tasks", process_count);
+    if (!builtins_sorted()) kernel_panic("shell: builtin table is not sorted");
+    task_start();
     while (1) asm volatile ("hlt");
 }
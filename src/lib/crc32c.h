@@ -0,0 +1,60 @@
+#include "pring.h"
+#include <stddef.h>
+
+#define CRC32C_POLY 0x82F63B78
+
+static uint32_t crc32c_table[256];
+static int crc32c_hw_available = -1;
+
+void crc32c_init() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c >> 1) ^ (CRC32C_POLY & -(c & 1));
+        }
+        crc32c_table[i] = c;
+    }
+    uint32_t eax, ebx, ecx, edx;
+    asm volatile ("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1), "c"(0));
+    crc32c_hw_available = (ecx >> 20) & 1;
+}
+
+uint32_t crc32c_sw(uint32_t crc, const void* data, size_t len) {
+    const uint8_t* p = data;
+    while (len--) {
+        crc = (crc >> 8) ^ crc32c_table[(crc ^ *p++) & 0xFF];
+    }
+    return crc;
+}
+
+uint32_t crc32c_hw(uint32_t crc, const void* data, size_t len) {
+    const uint8_t* p = data;
+    while (len && ((uintptr_t)p & 7)) {
+        asm ("crc32b %1, %0" : "+r"(crc) : "rm"(*p));
+        p++;
+        len--;
+    }
+    uint64_t crc64 = crc;
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        asm ("crc32q %1, %0" : "+r"(crc64) : "rm"(v));
+        p += 8;
+        len -= 8;
+    }
+    crc = (uint32_t)crc64;
+    while (len--) {
+        asm ("crc32b %1, %0" : "+r"(crc) : "rm"(*p));
+        p++;
+    }
+    return crc;
+}
+
+uint32_t crc32c_update(uint32_t crc, const void* data, size_t len) {
+    if (crc32c_hw_available < 0) crc32c_init();
+    return crc32c_hw_available ? crc32c_hw(crc, data, len) : crc32c_sw(crc, data, len);
+}
+
+uint32_t crc32c(const void* data, size_t len) {
+    return ~crc32c_update(0xFFFFFFFF, data, len);
+}
@@ -0,0 +1,221 @@
+#include "pring.h"
+#include <stddef.h>
+
+typedef struct {
+    uint32_t pixels[256][VGA_FONT_HEIGHT][VGA_FONT_WIDTH];
+    uint64_t valid[4];
+    int attr;
+} FbGlyphSlot;
+
+static const uint8_t fb_font8x8[95][8] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, {0x18, 0x3C, 0x3C, 0x18, 0x18, 0x00, 0x18, 0x00},
+    {0x36, 0x36, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, {0x36, 0x36, 0x7F, 0x36, 0x7F, 0x36, 0x36, 0x00},
+    {0x0C, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x0C, 0x00}, {0x00, 0x63, 0x33, 0x18, 0x0C, 0x66, 0x63, 0x00},
+    {0x1C, 0x36, 0x1C, 0x6E, 0x3B, 0x33, 0x6E, 0x00}, {0x06, 0x06, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00},
+    {0x18, 0x0C, 0x06, 0x06, 0x06, 0x0C, 0x18, 0x00}, {0x06, 0x0C, 0x18, 0x18, 0x18, 0x0C, 0x06, 0x00},
+    {0x00, 0x66, 0x3C, 0xFF, 0x3C, 0x66, 0x00, 0x00}, {0x00, 0x0C, 0x0C, 0x3F, 0x0C, 0x0C, 0x00, 0x00},
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x06}, {0x00, 0x00, 0x00, 0x3F, 0x00, 0x00, 0x00, 0x00},
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x00}, {0x60, 0x30, 0x18, 0x0C, 0x06, 0x03, 0x01, 0x00},
+    {0x3E, 0x63, 0x73, 0x7B, 0x6F, 0x67, 0x3E, 0x00}, {0x0C, 0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x3F, 0x00},
+    {0x1E, 0x33, 0x30, 0x1C, 0x06, 0x33, 0x3F, 0x00}, {0x1E, 0x33, 0x30, 0x1C, 0x30, 0x33, 0x1E, 0x00},
+    {0x38, 0x3C, 0x36, 0x33, 0x7F, 0x30, 0x78, 0x00}, {0x3F, 0x03, 0x1F, 0x30, 0x30, 0x33, 0x1E, 0x00},
+    {0x1C, 0x06, 0x03, 0x1F, 0x33, 0x33, 0x1E, 0x00}, {0x3F, 0x33, 0x30, 0x18, 0x0C, 0x0C, 0x0C, 0x00},
+    {0x1E, 0x33, 0x33, 0x1E, 0x33, 0x33, 0x1E, 0x00}, {0x1E, 0x33, 0x33, 0x3E, 0x30, 0x18, 0x0E, 0x00},
+    {0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x00}, {0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x06},
+    {0x18, 0x0C, 0x06, 0x03, 0x06, 0x0C, 0x18, 0x00}, {0x00, 0x00, 0x3F, 0x00, 0x00, 0x3F, 0x00, 0x00},
+    {0x06, 0x0C, 0x18, 0x30, 0x18, 0x0C, 0x06, 0x00}, {0x1E, 0x33, 0x30, 0x18, 0x0C, 0x00, 0x0C, 0x00},
+    {0x3E, 0x63, 0x7B, 0x7B, 0x7B, 0x03, 0x1E, 0x00}, {0x0C, 0x1E, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x00},
+    {0x3F, 0x66, 0x66, 0x3E, 0x66, 0x66, 0x3F, 0x00}, {0x3C, 0x66, 0x03, 0x03, 0x03, 0x66, 0x3C, 0x00},
+    {0x1F, 0x36, 0x66, 0x66, 0x66, 0x36, 0x1F, 0x00}, {0x7F, 0x46, 0x16, 0x1E, 0x16, 0x46, 0x7F, 0x00},
+    {0x7F, 0x46, 0x16, 0x1E, 0x16, 0x06, 0x0F, 0x00}, {0x3C, 0x66, 0x03, 0x03, 0x73, 0x66, 0x7C, 0x00},
+    {0x33, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x33, 0x00}, {0x1E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00},
+    {0x78, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E, 0x00}, {0x67, 0x66, 0x36, 0x1E, 0x36, 0x66, 0x67, 0x00},
+    {0x0F, 0x06, 0x06, 0x06, 0x46, 0x66, 0x7F, 0x00}, {0x63, 0x77, 0x7F, 0x7F, 0x6B, 0x63, 0x63, 0x00},
+    {0x63, 0x67, 0x6F, 0x7B, 0x73, 0x63, 0x63, 0x00}, {0x1C, 0x36, 0x63, 0x63, 0x63, 0x36, 0x1C, 0x00},
+    {0x3F, 0x66, 0x66, 0x3E, 0x06, 0x06, 0x0F, 0x00}, {0x1E, 0x33, 0x33, 0x33, 0x3B, 0x1E, 0x38, 0x00},
+    {0x3F, 0x66, 0x66, 0x3E, 0x36, 0x66, 0x67, 0x00}, {0x1E, 0x33, 0x07, 0x0E, 0x38, 0x33, 0x1E, 0x00},
+    {0x3F, 0x2D, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00}, {0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x3F, 0x00},
+    {0x33, 0x33, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00}, {0x63, 0x63, 0x63, 0x6B, 0x7F, 0x77, 0x63, 0x00},
+    {0x63, 0x63, 0x36, 0x1C, 0x1C, 0x36, 0x63, 0x00}, {0x33, 0x33, 0x33, 0x1E, 0x0C, 0x0C, 0x1E, 0x00},
+    {0x7F, 0x63, 0x31, 0x18, 0x4C, 0x66, 0x7F, 0x00}, {0x1E, 0x06, 0x06, 0x06, 0x06, 0x06, 0x1E, 0x00},
+    {0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x40, 0x00}, {0x1E, 0x18, 0x18, 0x18, 0x18, 0x18, 0x1E, 0x00},
+    {0x08, 0x1C, 0x36, 0x63, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF},
+    {0x0C, 0x0C, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x1E, 0x30, 0x3E, 0x33, 0x6E, 0x00},
+    {0x07, 0x06, 0x06, 0x3E, 0x66, 0x66, 0x3B, 0x00}, {0x00, 0x00, 0x1E, 0x33, 0x03, 0x33, 0x1E, 0x00},
+    {0x38, 0x30, 0x30, 0x3E, 0x33, 0x33, 0x6E, 0x00}, {0x00, 0x00, 0x1E, 0x33, 0x3F, 0x03, 0x1E, 0x00},
+    {0x1C, 0x36, 0x06, 0x0F, 0x06, 0x06, 0x0F, 0x00}, {0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x1F},
+    {0x07, 0x06, 0x36, 0x6E, 0x66, 0x66, 0x67, 0x00}, {0x0C, 0x00, 0x0E, 0x0C, 0x0C, 0x0C, 0x1E, 0x00},
+    {0x30, 0x00, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E}, {0x07, 0x06, 0x66, 0x36, 0x1E, 0x36, 0x67, 0x00},
+    {0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00}, {0x00, 0x00, 0x33, 0x7F, 0x7F, 0x6B, 0x63, 0x00},
+    {0x00, 0x00, 0x1F, 0x33, 0x33, 0x33, 0x33, 0x00}, {0x00, 0x00, 0x1E, 0x33, 0x33, 0x33, 0x1E, 0x00},
+    {0x00, 0x00, 0x3B, 0x66, 0x66, 0x3E, 0x06, 0x0F}, {0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x78},
+    {0x00, 0x00, 0x3B, 0x6E, 0x66, 0x06, 0x0F, 0x00}, {0x00, 0x00, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x00},
+    {0x08, 0x0C, 0x3E, 0x0C, 0x0C, 0x2C, 0x18, 0x00}, {0x00, 0x00, 0x33, 0x33, 0x33, 0x33, 0x6E, 0x00},
+    {0x00, 0x00, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00}, {0x00, 0x00, 0x63, 0x6B, 0x7F, 0x7F, 0x36, 0x00},
+    {0x00, 0x00, 0x63, 0x36, 0x1C, 0x36, 0x63, 0x00}, {0x00, 0x00, 0x33, 0x33, 0x33, 0x3E, 0x30, 0x1F},
+    {0x00, 0x00, 0x3F, 0x19, 0x0C, 0x26, 0x3F, 0x00}, {0x38, 0x0C, 0x0C, 0x07, 0x0C, 0x0C, 0x38, 0x00},
+    {0x18, 0x18, 0x18, 0x00, 0x18, 0x18, 0x18, 0x00}, {0x07, 0x0C, 0x0C, 0x38, 0x0C, 0x0C, 0x07, 0x00},
+    {0x6E, 0x3B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
+};
+
+static const uint32_t fb_palette[16] = {
+    0x000000, 0x0000AA, 0x00AA00, 0x00AAAA, 0xAA0000, 0xAA00AA, 0xAA5500, 0xAAAAAA,
+    0x555555, 0x5555FF, 0x55FF55, 0x55FFFF, 0xFF5555, 0xFF55FF, 0xFFFF55, 0xFFFFFF
+};
+
+uint8_t* fb_base = NULL;
+uint32_t fb_pitch = 0;
+uint32_t fb_width = 0;
+uint32_t fb_height = 0;
+FbGlyphSlot* fb_cache = NULL;
+int8_t fb_slot_of[256];
+uint32_t fb_next_slot = 0;
+uint64_t fb_glyph_hits = 0;
+uint64_t fb_glyph_misses = 0;
+size_t fb_cursor_x = 0;
+size_t fb_cursor_y = 0;
+bool fb_cursor_shown = false;
+
+static uint8_t fb_font_row(uint8_t c, uint32_t row) {
+    if (c >= 0x20 && c < 0x7F) return fb_font8x8[c - 0x20][row / 2];
+    if (c == 0xDB) return 0xFF;
+    return 0;
+}
+
+static const uint64_t* fb_glyph(uint16_t cell) {
+    uint8_t c = cell & 0xFF;
+    uint8_t attr = cell >> 8;
+    int s = fb_slot_of[attr];
+    if (s < 0) {
+        s = fb_next_slot;
+        fb_next_slot = (fb_next_slot + 1) % FB_CACHE_PAIRS;
+        if (fb_cache[s].attr >= 0) fb_slot_of[fb_cache[s].attr] = -1;
+        fb_cache[s].attr = attr;
+        memset(fb_cache[s].valid, 0, sizeof(fb_cache[s].valid));
+        fb_slot_of[attr] = s;
+    }
+    FbGlyphSlot* slot = &fb_cache[s];
+    if (slot->valid[c >> 6] & (1ULL << (c & 63))) {
+        fb_glyph_hits++;
+        return (const uint64_t*)slot->pixels[c];
+    }
+    uint32_t fg = fb_palette[attr & 0x0F];
+    uint32_t bg = fb_palette[attr >> 4];
+    for (uint32_t y = 0; y < VGA_FONT_HEIGHT; y++) {
+        uint8_t bits = fb_font_row(c, y);
+        for (uint32_t x = 0; x < VGA_FONT_WIDTH; x++) {
+            slot->pixels[c][y][x] = (bits >> x) & 1 ? fg : bg;
+        }
+    }
+    slot->valid[c >> 6] |= 1ULL << (c & 63);
+    fb_glyph_misses++;
+    return (const uint64_t*)slot->pixels[c];
+}
+
+static void fb_draw_cell(size_t x, size_t y, uint16_t cell) {
+    const uint64_t* g = fb_glyph(cell);
+    uint8_t* dst = fb_base + y * VGA_FONT_HEIGHT * fb_pitch + x * VGA_FONT_WIDTH * 4;
+    for (uint32_t r = 0; r < VGA_FONT_HEIGHT; r++) {
+        volatile uint64_t* d = (volatile uint64_t*)(dst + r * fb_pitch);
+        d[0] = g[0];
+        d[1] = g[1];
+        d[2] = g[2];
+        d[3] = g[3];
+        g += 4;
+    }
+}
+
+void fb_draw_row(size_t y, const uint16_t* cells) {
+    for (size_t x = 0; x < terminal_width; x++) {
+        fb_draw_cell(x, y, cells[x]);
+    }
+    if (y == fb_cursor_y) fb_cursor_shown = false;
+}
+
+void fb_move_cursor(size_t x, size_t y) {
+    if (fb_cursor_shown) {
+        if (x == fb_cursor_x && y == fb_cursor_y) return;
+        fb_draw_cell(fb_cursor_x, fb_cursor_y, tty_line(&ttys[current_tty], fb_cursor_y)[fb_cursor_x]);
+        fb_cursor_shown = false;
+    }
+    fb_cursor_x = x;
+    fb_cursor_y = y;
+    if (x >= terminal_width || y >= terminal_height) return;
+    uint32_t fg = fb_palette[(tty_line(&ttys[current_tty], y)[x] >> 8) & 0x0F];
+    for (uint32_t r = VGA_FONT_HEIGHT - 2; r < VGA_FONT_HEIGHT; r++) {
+        volatile uint32_t* d = (volatile uint32_t*)(fb_base + (y * VGA_FONT_HEIGHT + r) * fb_pitch) + x * VGA_FONT_WIDTH;
+        for (uint32_t i = 0; i < VGA_FONT_WIDTH; i++) d[i] = fg;
+    }
+    fb_cursor_shown = true;
+}
+
+void fb_scroll() {
+    size_t row_bytes = VGA_FONT_HEIGHT * fb_pitch;
+    uint64_t* dst = (uint64_t*)fb_base;
+    const uint64_t* src = (const uint64_t*)(fb_base + row_bytes);
+    for (size_t i = 0; i < (terminal_height - 1) * row_bytes / 8; i++) {
+        dst[i] = src[i];
+    }
+    if (fb_cursor_shown) {
+        fb_cursor_shown = false;
+        if (fb_cursor_y > 0) terminal_tty->dirty |= 1ULL << (fb_cursor_y - 1);
+    }
+}
+
+static bool fb_map(uint64_t addr, uint64_t size) {
+    uint64_t end = addr + size;
+    if (end <= IDENTITY_MAP_LIMIT) return true;
+    if (end > (1ULL << 39)) return false;
+    uintptr_t cr3;
+    asm volatile ("mov %%cr3, %0" : "=r"(cr3));
+    uint64_t* pml4 = (uint64_t*)(cr3 & ~0xFFFULL);
+    uint64_t* pdpt = (uint64_t*)(pml4[0] & ~0xFFFULL);
+    for (uint64_t a = addr & ~0x1FFFFFULL; a < end; a += 0x200000) {
+        size_t i = a >> 30;
+        if (!(pdpt[i] & 1)) {
+            uint8_t* page = malloc(8192);
+            if (page == NULL) return false;
+            uint64_t* pd = (uint64_t*)(((uintptr_t)page + 4095) & ~(uintptr_t)4095);
+            memset(pd, 0, 4096);
+            pdpt[i] = (uintptr_t)pd | 0x3;
+        } else if (pdpt[i] & 0x80) {
+            return false;
+        }
+        uint64_t* pd = (uint64_t*)(pdpt[i] & ~0xFFFULL);
+        pd[(a >> 21) & 511] = a | 0x8B;
+    }
+    asm volatile ("mov %%cr3, %%rax\n\tmov %%rax, %%cr3" ::: "rax", "memory");
+    return true;
+}
+
+bool fb_setup(uint64_t addr, uint32_t pitch, uint32_t width, uint32_t height) {
+    if (width < SCREEN_WIDTH * VGA_FONT_WIDTH || height < SCREEN_HEIGHT * VGA_FONT_HEIGHT) return false;
+    if (!fb_map(addr, (uint64_t)pitch * height)) return false;
+    fb_cache = malloc(FB_CACHE_PAIRS * sizeof(FbGlyphSlot));
+    if (fb_cache == NULL) return false;
+    for (int i = 0; i < FB_CACHE_PAIRS; i++) fb_cache[i].attr = -1;
+    memset(fb_slot_of, -1, sizeof(fb_slot_of));
+    fb_base = (uint8_t*)(uintptr_t)addr;
+    fb_pitch = pitch;
+    fb_width = width;
+    fb_height = height;
+    terminal_width = width / VGA_FONT_WIDTH;
+    terminal_height = height / VGA_FONT_HEIGHT;
+    if (terminal_width > TERM_MAX_WIDTH) terminal_width = TERM_MAX_WIDTH;
+    if (terminal_height > TERM_MAX_HEIGHT) terminal_height = TERM_MAX_HEIGHT;
+    fb_console = true;
+    return true;
+}
+
+bool fb_init(uintptr_t multiboot_info) {
+    if (multiboot_info == 0) return false;
+    if (multiboot_info >= IDENTITY_MAP_LIMIT) {
+        klogf(LOG_LEVEL_WARN, "fb: unmapped multiboot info %p", (void*)multiboot_info);
+        return false;
+    }
+    const uint8_t* mbi = (const uint8_t*)multiboot_info;
+    if (!(*(const uint32_t*)mbi & MULTIBOOT_INFO_FRAMEBUFFER)) return false;
+    if (mbi[109] != MULTIBOOT_FRAMEBUFFER_RGB || mbi[108] != 32) return false;
+    return fb_setup(*(const uint64_t*)(mbi + 88), *(const uint32_t*)(mbi + 96),
+                    *(const uint32_t*)(mbi + 100), *(const uint32_t*)(mbi + 104));
+}
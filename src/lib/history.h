@@ -0,0 +1,37 @@
+#include "pring.h"
+#include <stddef.h>
+
+const char* history_entry(int k) {
+    return command_history[(history_head + k) % HISTORY_SIZE];
+}
+
+void history_add(const char* cmd) {
+    size_t len = strlen(cmd);
+    if (len == 0) return;
+    if (len > MAX_CMD_LEN - 1) len = MAX_CMD_LEN - 1;
+    if (history_count > 0) {
+        const char* last = history_entry(history_count - 1);
+        if (strncmp(last, cmd, len) == 0 && last[len] == '\0') return;
+    }
+    char* slot;
+    if (history_count < HISTORY_SIZE) {
+        slot = command_history[(history_head + history_count++) % HISTORY_SIZE];
+    } else {
+        slot = command_history[history_head];
+        history_head = (history_head + 1) % HISTORY_SIZE;
+    }
+    memcpy(slot, cmd, len);
+    slot[len] = '\0';
+}
+
+int history_search(const char* query, int from) {
+    for (int k = from; k >= 0; k--) {
+        if (strstr(history_entry(k), query) != NULL) return k;
+    }
+    return -1;
+}
+
+void history_clear() {
+    history_head = 0;
+    history_count = 0;
+}
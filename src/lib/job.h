@@ -0,0 +1,121 @@
+#include "pring.h"
+#include <stddef.h>
+
+void command_name(char* name, size_t size, const char* cmd) {
+    while (*cmd == ' ') cmd++;
+    size_t len = 0;
+    while (cmd[len] && cmd[len] != ' ' && len < size - 1) len++;
+    memcpy(name, cmd, len);
+    name[len] = '\0';
+}
+
+Job* job_find(uint32_t pgid) {
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (jobs[i].used && jobs[i].pgid == pgid) return &jobs[i];
+    }
+    return NULL;
+}
+
+Job* job_get(int tty, int id) {
+    Job* found = NULL;
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (!jobs[i].used || jobs[i].tty != tty) continue;
+        if (id == 0 ? found == NULL || jobs[i].id > found->id : jobs[i].id == id) found = &jobs[i];
+    }
+    return found;
+}
+
+bool job_running(Job* job) {
+    for (int i = 0; i < process_count; i++) {
+        if (processes[i].pgid == job->pgid && processes[i].state != PROC_ZOMBIE) return true;
+    }
+    return false;
+}
+
+bool job_stopped(Job* job) {
+    for (int i = 0; i < process_count; i++) {
+        if (processes[i].pgid == job->pgid && processes[i].state == PROC_STOPPED) return true;
+    }
+    return false;
+}
+
+void job_reap(Job* job) {
+    for (int i = process_count - 1; i >= 0; i--) {
+        if (i < process_count && processes[i].pgid == job->pgid) task_reap(processes[i].pid);
+    }
+    for (int i = 0; i < MAX_PIPES; i++) {
+        if (pipes[i].used && pipes[i].pgid == job->pgid) pipe_release(&pipes[i]);
+    }
+    job->used = false;
+}
+
+static void job_main() {
+    Job* job = processes[current_process].arg;
+    char line[MAX_CMD_LEN];
+    strcpy(line, job->cmd);
+    execute_command(line);
+}
+
+Job* job_spawn(const char* cmd, bool background) {
+    Job* job = NULL;
+    int id = 1;
+    int tty = terminal_tty_index();
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (!jobs[i].used) {
+            if (job == NULL) job = &jobs[i];
+        } else if (jobs[i].tty == tty && jobs[i].id >= id) {
+            id = jobs[i].id + 1;
+        }
+    }
+    if (job == NULL) return NULL;
+    char name[32];
+    command_name(name, sizeof(name), cmd);
+    strncpy(job->cmd, cmd, MAX_CMD_LEN - 1);
+    job->cmd[MAX_CMD_LEN - 1] = '\0';
+    job->id = id;
+    job->tty = tty;
+    job->background = background;
+    int pid = task_create(name, job_main, tty, job);
+    if (pid == -1) return NULL;
+    Process* p = task_find(pid);
+    p->ppid = processes[current_process].pid;
+    job->pgid = pid;
+    job->used = true;
+    return job;
+}
+
+void job_wait(Job* job) {
+    TTY* tty = terminal_tty;
+    tty->fg_pgid = job->pgid;
+    tty->interrupted = false;
+    while (job_running(job) && !job_stopped(job)) {
+        keyboard_typeahead();
+        task_yield();
+    }
+    tty->fg_pgid = 0;
+    if (job_running(job)) {
+        job->background = true;
+        terminal_printf("\n[%d] Stopped\t%s\n", job->id, job->cmd);
+        return;
+    }
+    if (tty->interrupted) terminal_writestring("^C\n");
+    job_reap(job);
+}
+
+void job_notify() {
+    int tty = terminal_tty_index();
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (!jobs[i].used || jobs[i].tty != tty || job_running(&jobs[i])) continue;
+        if (jobs[i].background) terminal_printf("[%d] Done\t%s\n", jobs[i].id, jobs[i].cmd);
+        job_reap(&jobs[i]);
+    }
+}
+
+void job_claim_tty() {
+    if (!task_started) return;
+    Job* job = job_find(processes[current_process].pgid);
+    while (job != NULL && job->used && job->background) {
+        signal_group(job->pgid, SIGSTOP);
+        task_yield();
+    }
+}
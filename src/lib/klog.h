@@ -0,0 +1,161 @@
+#include "pring.h"
+#include <stddef.h>
+
+typedef struct {
+    uint64_t tsc;
+    uint32_t seq;
+    uint8_t level;
+    bool deferred;
+    union {
+        char message[KLOG_MSG_LEN];
+        struct {
+            const char* format;
+            uint64_t args[KLOG_ARGS];
+        };
+    };
+} KlogEntry;
+
+static const char* klog_levels[] = {"debug", "info", "warn", "error"};
+
+KlogEntry klog_ring[KLOG_ENTRIES];
+uint32_t klog_head = 0;
+uint32_t klog_clear_seq = 0;
+uint32_t klog_serial_seq = 0;
+bool klog_serial = false;
+uint64_t klog_boot_tsc = 0;
+
+static KlogEntry* klog_reserve(int level, uint32_t* seq) {
+    *seq = __atomic_fetch_add(&klog_head, 1, __ATOMIC_RELAXED);
+    KlogEntry* e = &klog_ring[*seq & (KLOG_ENTRIES - 1)];
+    __atomic_store_n(&e->seq, 0, __ATOMIC_RELAXED);
+    e->tsc = rdtsc();
+    e->level = level;
+    return e;
+}
+
+void klog(int level, const char* message) {
+    uint32_t seq;
+    KlogEntry* e = klog_reserve(level, &seq);
+    e->deferred = false;
+    size_t i = 0;
+    while (i < KLOG_MSG_LEN - 1 && message[i]) {
+        e->message[i] = message[i];
+        i++;
+    }
+    e->message[i] = '\0';
+    __atomic_store_n(&e->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+static int klog_collect(const char* format, va_list args, uint64_t* out) {
+    int n = 0;
+    while (*format) {
+        if (*format++ != '%') continue;
+        while (*format == '-' || *format == '+' || *format == ' ' || *format == '0' || *format == '#') format++;
+        while ((*format >= '0' && *format <= '9') || *format == '.' || *format == '*') {
+            if (*format++ == '*') {
+                if (n == KLOG_ARGS) return -1;
+                out[n++] = (uint64_t)(int64_t)va_arg(args, int);
+            }
+        }
+        int length = 0;
+        while (*format == 'h') format++;
+        while (*format == 'l' || *format == 'z') {
+            length++;
+            format++;
+        }
+        if (*format == '%' || *format == '\0') {
+            if (*format) format++;
+            continue;
+        }
+        if (*format == 's' || n == KLOG_ARGS) return -1;
+        switch (*format++) {
+            case 'd':
+            case 'i':
+            case 'c':
+                out[n++] = length ? (uint64_t)va_arg(args, long long) : (uint64_t)(int64_t)va_arg(args, int);
+                break;
+            case 'u':
+            case 'x':
+            case 'X':
+                out[n++] = length ? va_arg(args, unsigned long long) : va_arg(args, unsigned int);
+                break;
+            case 'p':
+                out[n++] = (uintptr_t)va_arg(args, void*);
+                break;
+            default:
+                return -1;
+        }
+    }
+    return n;
+}
+
+void klogf(int level, const char* format, ...) {
+    uint64_t argv[KLOG_ARGS];
+    va_list args;
+    va_start(args, format);
+    int n = klog_collect(format, args, argv);
+    va_end(args);
+    if (n < 0) {
+        char message[KLOG_MSG_LEN];
+        va_start(args, format);
+        vsnprintf(message, sizeof(message), format, args);
+        va_end(args);
+        klog(level, message);
+        return;
+    }
+    uint32_t seq;
+    KlogEntry* e = klog_reserve(level, &seq);
+    e->deferred = true;
+    e->format = format;
+    for (int i = 0; i < n; i++) e->args[i] = argv[i];
+    __atomic_store_n(&e->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+uint32_t klog_oldest() {
+    uint32_t head = __atomic_load_n(&klog_head, __ATOMIC_ACQUIRE);
+    return head > KLOG_ENTRIES ? head - KLOG_ENTRIES : 0;
+}
+
+bool klog_read(uint32_t seq, KlogEntry* out) {
+    KlogEntry* e = &klog_ring[seq & (KLOG_ENTRIES - 1)];
+    if (__atomic_load_n(&e->seq, __ATOMIC_ACQUIRE) != seq + 1) return false;
+    *out = *e;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&e->seq, __ATOMIC_ACQUIRE) == seq + 1;
+}
+
+int klog_format(const KlogEntry* e, char* buf, size_t size) {
+    uint64_t hz = tsc_hz ? tsc_hz : 1;
+    uint64_t ticks = e->tsc - klog_boot_tsc;
+    uint64_t sec = ticks / hz;
+    uint64_t usec = (ticks % hz) * 1000000 / hz;
+    char message[KLOG_MSG_LEN];
+    const char* text = e->message;
+    if (e->deferred) {
+        // args were widened to 64-bit slots, which va_arg reads correctly on x86-64
+        snprintf(message, sizeof(message), e->format, e->args[0], e->args[1], e->args[2], e->args[3], e->args[4]);
+        text = message;
+    }
+    return snprintf(buf, size, "[%5llu.%06llu] %-5s %s\n", (unsigned long long)sec, (unsigned long long)usec,
+                    klog_levels[e->level & 3], text);
+}
+
+void klog_mirror() {
+    if (!klog_serial || !serial_present) return;
+    uint32_t head = __atomic_load_n(&klog_head, __ATOMIC_ACQUIRE);
+    uint32_t oldest = klog_oldest();
+    if (klog_serial_seq < oldest) klog_serial_seq = oldest;
+    while (klog_serial_seq < head) {
+        KlogEntry e;
+        if (!klog_read(klog_serial_seq, &e)) break;
+        char line[KLOG_MSG_LEN + 32];
+        int n = klog_format(&e, line, sizeof(line));
+        serial_write(line, n < (int)sizeof(line) ? n : (int)sizeof(line) - 1);
+        klog_serial_seq++;
+    }
+}
+
+void klog_init() {
+    klog_boot_tsc = rdtsc();
+    tsc_calibrate();
+}
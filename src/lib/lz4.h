@@ -0,0 +1,136 @@
+#include "pring.h"
+#include <stddef.h>
+
+#define LZ4_HASH_LOG 12
+#define LZ4_MIN_MATCH 4
+#define LZ4_MAX_INPUT 0xFFFF
+#define LZ4_LAST_LITERALS 5
+#define LZ4_MF_LIMIT 12
+
+static uint16_t lz4_hash_table[1 << LZ4_HASH_LOG];
+
+static inline uint32_t lz4_read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t lz4_hash(uint32_t seq) {
+    return (seq * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+static uint8_t* lz4_write_length(uint8_t* op, uint32_t len) {
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+static uint8_t* lz4_write_literals(uint8_t* op, const uint8_t* anchor, uint32_t lit) {
+    uint8_t* token = op++;
+    *token = (lit >= 15 ? 15 : lit) << 4;
+    if (lit >= 15) op = lz4_write_length(op, lit - 15);
+    memcpy(op, anchor, lit);
+    op += lit;
+    return op;
+}
+
+int lz4_compress(const uint8_t* src, int src_len, uint8_t* dst, int dst_cap) {
+    if (src_len < 0 || src_len > LZ4_MAX_INPUT) return -1;
+    const uint8_t* ip = src;
+    const uint8_t* anchor = src;
+    const uint8_t* const iend = src + src_len;
+    const uint8_t* const mflimit = iend - LZ4_MF_LIMIT;
+    const uint8_t* const matchlimit = iend - LZ4_LAST_LITERALS;
+    uint8_t* op = dst;
+    uint8_t* const oend = dst + dst_cap;
+
+    memset(lz4_hash_table, 0, sizeof(lz4_hash_table));
+    if (src_len > LZ4_MF_LIMIT) {
+        while (ip < mflimit) {
+            uint32_t seq = lz4_read32(ip);
+            uint32_t h = lz4_hash(seq);
+            const uint8_t* ref = src + lz4_hash_table[h];
+            lz4_hash_table[h] = (uint16_t)(ip - src);
+            if (ref >= ip || lz4_read32(ref) != seq) {
+                ip++;
+                continue;
+            }
+            while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+            const uint8_t* mp = ip + LZ4_MIN_MATCH;
+            const uint8_t* rp = ref + LZ4_MIN_MATCH;
+            while (mp < matchlimit && *mp == *rp) {
+                mp++;
+                rp++;
+            }
+            uint32_t lit = ip - anchor;
+            uint32_t match_len = mp - ip - LZ4_MIN_MATCH;
+            if ((size_t)(oend - op) < 1 + lit / 255 + 1 + lit + 2 + match_len / 255 + 1) return -1;
+            uint8_t* token = op;
+            op = lz4_write_literals(op, anchor, lit);
+            uint16_t offset = (uint16_t)(ip - ref);
+            *op++ = offset & 0xFF;
+            *op++ = offset >> 8;
+            *token |= match_len >= 15 ? 15 : match_len;
+            if (match_len >= 15) op = lz4_write_length(op, match_len - 15);
+            ip = mp;
+            anchor = ip;
+        }
+    }
+
+    uint32_t lit = iend - anchor;
+    if ((size_t)(oend - op) < 1 + lit / 255 + 1 + lit) return -1;
+    op = lz4_write_literals(op, anchor, lit);
+    return op - dst;
+}
+
+int lz4_decompress(const uint8_t* src, int src_len, uint8_t* dst, int dst_cap) {
+    const uint8_t* ip = src;
+    const uint8_t* const iend = src + src_len;
+    uint8_t* op = dst;
+    uint8_t* const oend = dst + dst_cap;
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+        uint32_t lit = token >> 4;
+        if (lit == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) return -1;
+                b = *ip++;
+                lit += b;
+            } while (b == 255);
+        }
+        if (lit > (size_t)(iend - ip) || lit > (size_t)(oend - op)) return -1;
+        memcpy(op, ip, lit);
+        op += lit;
+        ip += lit;
+        if (ip >= iend) break;
+
+        if (iend - ip < 2) return -1;
+        uint32_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - dst)) return -1;
+        uint32_t match_len = token & 0x0F;
+        if (match_len == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) return -1;
+                b = *ip++;
+                match_len += b;
+            } while (b == 255);
+        }
+        match_len += LZ4_MIN_MATCH;
+        if (match_len > (size_t)(oend - op)) return -1;
+        const uint8_t* ref = op - offset;
+        while (match_len--) {
+            *op++ = *ref++;
+        }
+    }
+    return op - dst;
+}
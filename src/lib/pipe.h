@@ -0,0 +1,71 @@
+#include "pring.h"
+#include <stddef.h>
+
+Pipe* pipe_alloc() {
+    for (int i = 0; i < MAX_PIPES; i++) {
+        if (pipes[i].used) continue;
+        memset(&pipes[i], 0, sizeof(Pipe));
+        pipes[i].used = true;
+        pipes[i].is_empty = true;
+        pipes[i].pgid = processes[current_process].pgid;
+        pipe_count++;
+        return &pipes[i];
+    }
+    return NULL;
+}
+
+void pipe_release(Pipe* pipe) {
+    if (pipe == NULL || !pipe->used) return;
+    pipe->used = false;
+    pipe_count--;
+}
+
+void pipe_close(Pipe* pipe) {
+    if (pipe != NULL) pipe->closed = true;
+}
+
+void pipe_write(Pipe* pipe, const char* data, size_t size) {
+    while (size > 0) {
+        if (pipe->broken) return;
+        size_t used = pipe->write_pos - pipe->read_pos;
+        if (used == PIPE_BUF_SIZE) {
+            task_yield();
+            continue;
+        }
+        size_t off = pipe->write_pos % PIPE_BUF_SIZE;
+        size_t n = PIPE_BUF_SIZE - used;
+        if (n > PIPE_BUF_SIZE - off) n = PIPE_BUF_SIZE - off;
+        if (n > size) n = size;
+        memcpy(pipe->buffer + off, data, n);
+        pipe->write_pos += n;
+        pipe->is_empty = false;
+        pipe->is_full = pipe->write_pos - pipe->read_pos == PIPE_BUF_SIZE;
+        data += n;
+        size -= n;
+    }
+}
+
+int pipe_read(Pipe* pipe, char* buf, size_t size) {
+    while (pipe->write_pos == pipe->read_pos) {
+        if (pipe->closed) return 0;
+        task_yield();
+    }
+    size_t used = pipe->write_pos - pipe->read_pos;
+    size_t off = pipe->read_pos % PIPE_BUF_SIZE;
+    size_t n = used < PIPE_BUF_SIZE - off ? used : PIPE_BUF_SIZE - off;
+    if (n > size) n = size;
+    memcpy(buf, pipe->buffer + off, n);
+    pipe->read_pos += n;
+    pipe->is_full = false;
+    pipe->is_empty = pipe->write_pos == pipe->read_pos;
+    return n;
+}
+
+void pipe_sink(void* ctx, const char* data, size_t size) {
+    pipe_write(ctx, data, size);
+}
+
+int stream_read(char* buf, size_t size) {
+    if (terminal_in == NULL) return -1;
+    return pipe_read(terminal_in, buf, size);
+}
@@ -9,13 +9,41 @@ void init_timer() {
     boot_time = timer_ticks;
 }
 
+uint64_t tsc_calibrate() {
+    if (tsc_hz) return tsc_hz;
+    uint16_t latch = PIT_FREQUENCY / 100;
+    outb(0x61, (inb(0x61) & 0xFD) | 0x01);
+    outb(PIT_COMMAND, 0xB0);
+    outb(0x42, latch & 0xFF);
+    outb(0x42, (latch >> 8) & 0xFF);
+    uint64_t start = rdtsc();
+    while (!(inb(0x61) & 0x20));
+    tsc_hz = (rdtsc() - start) * 100;
+    outb(0x61, inb(0x61) & 0xFC);
+    return tsc_hz;
+}
+
+void mem_init(uintptr_t multiboot_info) {
+    uintptr_t top = 0x100000 + (uintptr_t)TOTAL_MEMORY_KB * 1024;
+    if (multiboot_info != 0 && multiboot_info < IDENTITY_MAP_LIMIT) {
+        const uint32_t* mbi = (const uint32_t*)multiboot_info;
+        if (mbi[0] & MULTIBOOT_INFO_MEMORY) top = 0x100000 + (uintptr_t)mbi[2] * 1024;
+    }
+    if (top > IDENTITY_MAP_LIMIT) top = IDENTITY_MAP_LIMIT;
+    total_memory_kb = top / 1024;
+    heap_start = ((uintptr_t)_end + 4095) & ~(uintptr_t)4095;
+    heap_end = top > heap_start ? top : heap_start;
+    next_node_addr = heap_start;
+}
+
 void* malloc(size_t size) {
-    if (heap_start + size > heap_end) {
+    uintptr_t addr = (heap_start + 15) & ~(uintptr_t)15;
+    if (addr > heap_end || size > heap_end - addr) {
         return NULL;
     }
-    void* ptr = (void*)heap_start;
-    heap_start += size;
-    return ptr;
+    heap_start = addr + size;
+    next_node_addr = heap_start;
+    return (void*)addr;
 }
 
 void free(void* ptr) {
@@ -1,14 +1,24 @@
 volatile uint16_t* terminal_buffer = VIDEO_MEMORY;
+uint16_t terminal_cursor = 0xFFFF;
+uint16_t terminal_origin = 0;
+uint16_t terminal_crtc_start = 0xFFFF;
 size_t terminal_row = 0;
 size_t terminal_column = 0;
 uint8_t terminal_color = (COLOR_BLACK << 4) | COLOR_WHITE;
+size_t terminal_width = SCREEN_WIDTH;
+size_t terminal_height = SCREEN_HEIGHT;
+bool fb_console = false;
 
 size_t strlen(const char* s);
 void* memcpy(void* dest, const void* src, size_t n);
+void* memmove(void* dest, const void* src, size_t n);
 void* memset(void* s, int c, size_t n);
 int memcmp(const void* s1, const void* s2, size_t n);
 char* strchr(const char* s, int c);
+char* strrchr(const char* s, int c);
 char* strstr(const char* haystack, const char* needle);
+void* memchr(const void* s, int c, size_t n);
+void* memmem(const void* haystack, size_t hl, const void* needle, size_t l);
 int strcmp(const char* s1, const char* s2);
 char* strcpy(char* dest, const char* src);
 char* strcat(char* dest, const char* src);
@@ -21,36 +31,139 @@ void free(void* ptr);
 void* calloc(size_t nmemb, size_t size);
 void* realloc(void* ptr, size_t size);
 
+typedef uint8_t mem_v16 __attribute__((vector_size(16), aligned(1), may_alias));
+typedef uint64_t mem_u64 __attribute__((aligned(1), may_alias));
+typedef uint32_t mem_u32 __attribute__((aligned(1), may_alias));
+typedef uint16_t mem_u16 __attribute__((aligned(1), may_alias));
+
+#define MEM_ERMS_THRESHOLD 2048
+
+bool mem_erms = false;
+
+void mem_detect() {
+    uint32_t eax, ebx, ecx, edx;
+    asm volatile ("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(0), "c"(0));
+    if (eax < 7) return;
+    asm volatile ("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(7), "c"(0));
+    mem_erms = (ebx >> 9) & 1;
+}
+
+static inline void mem_copy_small(uint8_t* d, const uint8_t* s, size_t n) {
+    if (n >= 16) {
+        mem_v16 a = *(const mem_v16*)s;
+        mem_v16 b = *(const mem_v16*)(s + n - 16);
+        *(mem_v16*)d = a;
+        *(mem_v16*)(d + n - 16) = b;
+    } else if (n >= 8) {
+        uint64_t a = *(const mem_u64*)s;
+        uint64_t b = *(const mem_u64*)(s + n - 8);
+        *(mem_u64*)d = a;
+        *(mem_u64*)(d + n - 8) = b;
+    } else if (n >= 4) {
+        uint32_t a = *(const mem_u32*)s;
+        uint32_t b = *(const mem_u32*)(s + n - 4);
+        *(mem_u32*)d = a;
+        *(mem_u32*)(d + n - 4) = b;
+    } else if (n >= 2) {
+        uint16_t a = *(const mem_u16*)s;
+        uint16_t b = *(const mem_u16*)(s + n - 2);
+        *(mem_u16*)d = a;
+        *(mem_u16*)(d + n - 2) = b;
+    } else if (n == 1) {
+        *d = *s;
+    }
+}
+
 void* memcpy(void* dest, const void* src, size_t n) {
-    char* d = (char*)dest;
-    const char* s = (const char*)src;
-    for (size_t i = 0; i < n; i++) {
-        d[i] = s[i];
+    uint8_t* d = dest;
+    const uint8_t* s = src;
+    if (n <= 32) {
+        mem_copy_small(d, s, n);
+        return dest;
+    }
+    if (n >= MEM_ERMS_THRESHOLD && mem_erms) {
+        asm volatile ("rep movsb" : "+D"(d), "+S"(s), "+c"(n) : : "memory");
+        return dest;
+    }
+    mem_v16 tail = *(const mem_v16*)(s + n - 16);
+    uint8_t* end = d + n - 16;
+    for (size_t i = 0; i < n - 16; i += 16) {
+        *(mem_v16*)(d + i) = *(const mem_v16*)(s + i);
     }
+    *(mem_v16*)end = tail;
     return dest;
 }
 
-extern int mouse_x, mouse_y, mouse_buttons;
+void* memmove(void* dest, const void* src, size_t n) {
+    uint8_t* d = dest;
+    const uint8_t* s = src;
+    if ((uintptr_t)d - (uintptr_t)s >= n) return memcpy(dest, src, n);
+    if (n <= 32) {
+        mem_copy_small(d, s, n);
+        return dest;
+    }
+    mem_v16 head = *(const mem_v16*)s;
+    size_t i = n;
+    while (i > 16) {
+        i -= 16;
+        *(mem_v16*)(d + i) = *(const mem_v16*)(s + i);
+    }
+    *(mem_v16*)d = head;
+    return dest;
+}
 
-void vga_set_font(const uint8_t* new_font);
-void vga_save_current_font(uint8_t* buffer);
+extern int mouse_x, mouse_y, mouse_buttons;
 
 void* memset(void* s, int c, size_t n) {
-    unsigned char* p = s;
-    while (n--) {
-        *p++ = (unsigned char)c;
+    uint8_t* d = s;
+    uint64_t v = 0x0101010101010101ULL * (uint8_t)c;
+    if (n >= 16) {
+        mem_v16 w = (mem_v16){0} + (uint8_t)c;
+        if (n >= MEM_ERMS_THRESHOLD && mem_erms) {
+            asm volatile ("rep stosb" : "+D"(d), "+c"(n) : "a"(c) : "memory");
+            return s;
+        }
+        *(mem_v16*)(d + n - 16) = w;
+        for (size_t i = 0; i < n - 16; i += 16) {
+            *(mem_v16*)(d + i) = w;
+        }
+    } else if (n >= 8) {
+        *(mem_u64*)d = v;
+        *(mem_u64*)(d + n - 8) = v;
+    } else if (n >= 4) {
+        *(mem_u32*)d = (uint32_t)v;
+        *(mem_u32*)(d + n - 4) = (uint32_t)v;
+    } else if (n >= 2) {
+        *(mem_u16*)d = (uint16_t)v;
+        *(mem_u16*)(d + n - 2) = (uint16_t)v;
+    } else if (n == 1) {
+        *d = (uint8_t)c;
     }
     return s;
 }
 
 int memcmp(const void* s1, const void* s2, size_t n) {
-    const unsigned char* p1 = s1, *p2 = s2;
-    while (n--) {
-        if (*p1 != *p2) {
-            return *p1 - *p2;
+    const uint8_t* p1 = s1, *p2 = s2;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        mem_v16 a = *(const mem_v16*)(p1 + i);
+        mem_v16 b = *(const mem_v16*)(p2 + i);
+        uint32_t mask = __builtin_ia32_pmovmskb128((__attribute__((vector_size(16))) char)(a == b));
+        if (mask != 0xFFFF) {
+            size_t k = i + __builtin_ctz(~mask);
+            return p1[k] - p2[k];
+        }
+    }
+    for (; i + 8 <= n; i += 8) {
+        uint64_t a = *(const mem_u64*)(p1 + i);
+        uint64_t b = *(const mem_u64*)(p2 + i);
+        if (a != b) {
+            size_t k = i + __builtin_ctzll(a ^ b) / 8;
+            return p1[k] - p2[k];
         }
-        p1++;
-        p2++;
+    }
+    for (; i < n; i++) {
+        if (p1[i] != p2[i]) return p1[i] - p2[i];
     }
     return 0;
 }
@@ -58,35 +171,158 @@ int memcmp(const void* s1, const void* s2, size_t n) {
 #define VGA_FONT_WIDTH 8
 #define VGA_FONT_HEIGHT 16
 #define VGA_FONT_SIZE (256 * VGA_FONT_HEIGHT)
+#define VGA_FONT_STRIDE 32
+#define VGA_FONT_PLANE 0xA0000
+#define VGA_FONT_SLOTS 4
+#define VGA_FONT_ORIGINAL 0
 
 void vga_set_font(const uint8_t* new_font);
 void vga_save_current_font(uint8_t* buffer);
 void vga_restore_font(void);
+void vga_font_capture();
+int vga_font_register(int id, const uint8_t* font);
+bool vga_font_load(int id);
+
+#define STR_ONES 0x0101010101010101ULL
+#define STR_HIGHS 0x8080808080808080ULL
+#define STR_PAGE_SIZE 4096
+
+static inline uint64_t str_zero_bytes(uint64_t v) {
+    return (v - STR_ONES) & ~v & STR_HIGHS;
+}
+
+static inline uint64_t str_lower(uint64_t v) {
+    uint64_t low = v & ~STR_HIGHS;
+    uint64_t upper = ((low + (0x80 - 'A') * STR_ONES) ^ (low + (0x80 - 'Z' - 1) * STR_ONES)) & ~v & STR_HIGHS;
+    return v | (upper >> 2);
+}
+
+static inline bool str_word_safe(const void* a, const void* b) {
+    return ((uintptr_t)a & (STR_PAGE_SIZE - 1)) <= STR_PAGE_SIZE - 8 &&
+           ((uintptr_t)b & (STR_PAGE_SIZE - 1)) <= STR_PAGE_SIZE - 8;
+}
 
 char* strchr(const char* s, int c) {
-    while (*s != '\0') {
-        if (*s == c) {
-            return (char*)s;
-        }
-        s++;
+    const uint8_t* p = (const uint8_t*)((uintptr_t)s & ~(uintptr_t)7);
+    uint64_t pre = (1ULL << (((uintptr_t)s & 7) * 8)) - 1;
+    uint64_t cc = STR_ONES * (uint8_t)c;
+    uint64_t v = *(const mem_u64*)p;
+    uint64_t z = str_zero_bytes(v | pre) | str_zero_bytes((v ^ cc) | pre);
+    while (z == 0) {
+        p += 8;
+        v = *(const mem_u64*)p;
+        z = str_zero_bytes(v) | str_zero_bytes(v ^ cc);
+    }
+    p += __builtin_ctzll(z) / 8;
+    return *p != '\0' ? (char*)p : NULL;
+}
+
+char* strrchr(const char* s, int c) {
+    const char* last = NULL;
+    while ((s = strchr(s, c)) != NULL) last = s++;
+    return (char*)last;
+}
+
+void* memchr(const void* s, int c, size_t n) {
+    const uint8_t* p = s;
+    uint64_t cc = STR_ONES * (uint8_t)c;
+    for (; n >= 8; p += 8, n -= 8) {
+        uint64_t z = str_zero_bytes(*(const mem_u64*)p ^ cc);
+        if (z) return (void*)(p + __builtin_ctzll(z) / 8);
+    }
+    for (; n; p++, n--) {
+        if (*p == (uint8_t)c) return (void*)p;
     }
     return NULL;
 }
 
-char* strstr(const char* haystack, const char* needle) {
-    size_t needle_len = strlen(needle);
-    if (needle_len == 0) {
-        return (char*)haystack;
+static size_t str_max_suffix(const uint8_t* n, size_t l, bool reverse, size_t* period) {
+    size_t ip = (size_t)-1, jp = 0, k = 1, p = 1;
+    while (jp + k < l) {
+        uint8_t a = n[ip + k];
+        uint8_t b = n[jp + k];
+        if (a == b) {
+            if (k == p) {
+                jp += p;
+                k = 1;
+            } else {
+                k++;
+            }
+        } else if (reverse ? a < b : a > b) {
+            jp += k;
+            k = 1;
+            p = jp - ip;
+        } else {
+            ip = jp++;
+            k = p = 1;
+        }
     }
-    
-    for (; *haystack; haystack++) {
-        if (*haystack == *needle && !memcmp(haystack, needle, needle_len)) {
-            return (char*)haystack;
+    *period = p;
+    return ip;
+}
+
+void* memmem(const void* haystack, size_t hl, const void* needle, size_t l) {
+    const uint8_t* h = haystack;
+    const uint8_t* n = needle;
+    if (l == 0) return (void*)h;
+    if (hl < l) return NULL;
+    if (l == 1) return memchr(h, n[0], hl);
+    const uint8_t* z = h + hl;
+
+    uint64_t byteset[4] = {0};
+    uint32_t shift[256];
+    for (size_t i = 0; i < l; i++) {
+        byteset[n[i] >> 6] |= 1ULL << (n[i] & 63);
+        shift[n[i]] = i + 1;
+    }
+
+    size_t p, p0;
+    size_t ms = str_max_suffix(n, l, false, &p0);
+    size_t ms1 = str_max_suffix(n, l, true, &p);
+    if (ms1 + 1 > ms + 1) ms = ms1;
+    else p = p0;
+
+    size_t mem0;
+    if (memcmp(n, n + p, ms + 1) != 0) {
+        mem0 = 0;
+        p = (ms > l - ms - 1 ? ms : l - ms - 1) + 1;
+    } else {
+        mem0 = l - p;
+    }
+    size_t mem = 0;
+
+    while ((size_t)(z - h) >= l) {
+        uint8_t last = h[l - 1];
+        if (!(byteset[last >> 6] & (1ULL << (last & 63)))) {
+            h += l;
+            mem = 0;
+            continue;
+        }
+        size_t k = l - shift[last];
+        if (k) {
+            if (mem0 && mem && k < p) k = l - p;
+            h += k;
+            mem = 0;
+            continue;
         }
+        for (k = ms + 1 > mem ? ms + 1 : mem; k < l && n[k] == h[k]; k++);
+        if (k < l) {
+            h += k - ms;
+            mem = 0;
+            continue;
+        }
+        for (k = ms + 1; k > mem && n[k - 1] == h[k - 1]; k--);
+        if (k <= mem) return (void*)h;
+        h += p;
+        mem = mem0;
     }
     return NULL;
 }
 
+char* strstr(const char* haystack, const char* needle) {
+    return memmem(haystack, strlen(haystack), needle, strlen(needle));
+}
+
 int atoi(const char* str) {
     int res = 0;
     while (*str >= '0' && *str <= '9') {
@@ -96,22 +332,50 @@ int atoi(const char* str) {
     return res;
 }
 
+uint32_t parse_size(const char* str) {
+    uint32_t res = 0;
+    while (*str >= '0' && *str <= '9') {
+        res = res * 10 + (*str - '0');
+        str++;
+    }
+    if (*str == 'k' || *str == 'K') res *= 1024;
+    else if (*str == 'm' || *str == 'M') res *= 1024 * 1024;
+    return res;
+}
+
 static inline int abs(int n) {
     return (n < 0) ? -n : n;
 }
 
 int strcmp(const char* s1, const char* s2) {
-    while (*s1 && (*s1 == *s2)) {
-        s1++;
-        s2++;
+    const uint8_t* a = (const uint8_t*)s1;
+    const uint8_t* b = (const uint8_t*)s2;
+    while (1) {
+        if (str_word_safe(a, b)) {
+            uint64_t x = *(const mem_u64*)a;
+            uint64_t z = str_zero_bytes(x) | (x ^ *(const mem_u64*)b);
+            if (z == 0) {
+                a += 8;
+                b += 8;
+                continue;
+            }
+            size_t k = __builtin_ctzll(z) / 8;
+            return a[k] - b[k];
+        }
+        if (*a == '\0' || *a != *b) return *a - *b;
+        a++;
+        b++;
     }
-    return *(const unsigned char*)s1 - *(const unsigned char*)s2;
 }
 
 size_t strlen(const char* str) {
-    size_t len = 0;
-    while (str[len]) len++;
-    return len;
+    const uint8_t* p = (const uint8_t*)((uintptr_t)str & ~(uintptr_t)7);
+    uint64_t z = str_zero_bytes(*(const mem_u64*)p | ((1ULL << (((uintptr_t)str & 7) * 8)) - 1));
+    while (z == 0) {
+        p += 8;
+        z = str_zero_bytes(*(const mem_u64*)p);
+    }
+    return (const char*)p + __builtin_ctzll(z) / 8 - str;
 }
 
 char* strcpy(char* dest, const char* src) {
@@ -135,15 +399,27 @@ char* strncpy(char* dest, const char* src, size_t n) {
 }
 
 int strncmp(const char* s1, const char* s2, size_t n) {
-    while (n && *s1 && (*s1 == *s2)) {
-        s1++;
-        s2++;
+    const uint8_t* a = (const uint8_t*)s1;
+    const uint8_t* b = (const uint8_t*)s2;
+    while (n) {
+        if (n >= 8 && str_word_safe(a, b)) {
+            uint64_t x = *(const mem_u64*)a;
+            uint64_t z = str_zero_bytes(x) | (x ^ *(const mem_u64*)b);
+            if (z == 0) {
+                a += 8;
+                b += 8;
+                n -= 8;
+                continue;
+            }
+            size_t k = __builtin_ctzll(z) / 8;
+            return a[k] - b[k];
+        }
+        if (*a == '\0' || *a != *b) return *a - *b;
+        a++;
+        b++;
         n--;
     }
-    if (n == 0) {
-        return 0;
-    }
-    return *(const unsigned char*)s1 - *(const unsigned char*)s2;
+    return 0;
 }
 
 char* strpbrk(const char* s, const char* accept) {
@@ -203,15 +479,30 @@ typedef struct {
     uint32_t mtime;
     uint32_t dtime;
     uint32_t blocks;
+    uint32_t flags;
     uint32_t block[INODE_DIRECT_BLOCKS];
+    uint16_t clen[BKFS_CLUSTERS];
+    uint32_t checksum;
 } Inode;
 
+typedef struct {
+    uint32_t hash;
+    uint32_t block;
+} DedupEntry;
+
+typedef struct {
+    uint32_t hash;
+    uint32_t file;
+} DirentEntry;
+
 typedef struct {
     char name[32];
     uint32_t inode;
     uint32_t parent_inode;
 } FileEntry;
 
+typedef struct Stream Stream;
+
 typedef struct {
     uint32_t pid;
     uint32_t ppid;
@@ -222,6 +513,13 @@ typedef struct {
     uintptr_t stack_ptr;
     uintptr_t entry_point;
     uint32_t exit_code;
+    int tty;
+    uint32_t cwd;
+    uint8_t* stack;
+    Stream* out;
+    struct Pipe* in;
+    void* arg;
+    uint8_t script_depth;
 } Process;
 
 typedef struct {
@@ -261,28 +559,78 @@ typedef struct {
     size_t row;
     size_t column;
     uint8_t color;
-    uint16_t buffer[SCREEN_HEIGHT][SCREEN_WIDTH];
+    uint16_t buffer[TERM_MAX_HEIGHT][TERM_MAX_WIDTH];
     char input_buffer[MAX_CMD_LEN];
     int input_pos;
     uint32_t current_inode;
     bool logged_in;
+    size_t top;
+    uint64_t dirty;
+    uint16_t* scrollback;
+    uint32_t scrollback_head;
+    uint32_t scrollback_count;
+    uint32_t scrollback_view;
+    uint32_t fg_pgid;
+    bool interrupted;
+    char typeahead[16];
+    uint8_t typeahead_len;
 } TTY;
 
 typedef struct {
-    char buffer[1024];
+    uint32_t inode;
+    uint32_t unit;
+    uint32_t base;
+    uint32_t len;
+    bool error;
+    uint8_t buf[BKFS_CLUSTER_SIZE];
+} BkfsWriter;
+
+typedef struct Pipe {
+    char buffer[PIPE_BUF_SIZE];
     size_t read_pos;
     size_t write_pos;
     bool is_full;
     bool is_empty;
+    bool used;
+    bool closed;
+    bool broken;
+    uint32_t pgid;
 } Pipe;
 
+typedef struct {
+    int id;
+    uint32_t pgid;
+    int tty;
+    bool used;
+    bool background;
+    char cmd[MAX_CMD_LEN];
+} Job;
+
+typedef void (*builtin_fn)(char** args, int arg_count);
+typedef void (*line_fn)(void* ctx, char* line, uint32_t line_no);
+
+typedef struct {
+    const char* name;
+    builtin_fn run;
+    uint8_t min_args;
+    const char* usage;
+    const char* help;
+    uint8_t flags;
+} Builtin;
+
+extern const Builtin builtins[];
+extern const size_t builtin_count;
+
 volatile uint32_t timer_ticks = 0;
 #define TIMER_HZ 18.2
 uint32_t boot_time = 0;
+uint64_t tsc_hz = 0;
 
+extern char _end[];
 static uintptr_t next_node_addr = 0x100000;
 static uintptr_t heap_start = 0x200000;
 static uintptr_t heap_end = 0x400000;
+uint32_t total_memory_kb = TOTAL_MEMORY_KB;
 
 Disk disks[] = {
     {"sda", 500ULL * 1024 * 1024, 250ULL * 1024 * 1024},
@@ -290,23 +638,59 @@ Disk disks[] = {
 };
 int disk_count = 2;
 
-File files[MAX_FILES];
+File* files;
 int file_count = 5;
 uint32_t current_inode = 1;
-
-Inode inodes[MAX_INODES];
-uint8_t blocks[MAX_BLOCKS][BLOCK_SIZE];
-bool block_used[MAX_BLOCKS];
-uint32_t free_blocks = MAX_BLOCKS;
-uint32_t free_inodes = MAX_INODES;
+uint32_t max_files = 0;
+uint32_t max_inodes = 0;
+uint32_t max_blocks = 0;
+
+Inode* inodes;
+uint8_t (*blocks)[BLOCK_SIZE];
+bool* block_used;
+uint32_t* block_crc;
+bool bkfs_csum_enabled = true;
+uint16_t* block_refs;
+DedupEntry* dedup_table;
+uint32_t dedup_table_size = 0;
+uint32_t dedup_entries = 0;
+uint32_t dedup_hits = 0;
+bool bkfs_dedup_enabled = false;
+DirentEntry* dirent_index;
+uint32_t dirent_index_size = 0;
+uint32_t* inode_dirent;
+uint32_t free_blocks = 0;
+uint32_t free_inodes = 0;
 
 TTY ttys[MAX_TTYS];
 int current_tty = 0;
+TTY* terminal_tty = &ttys[0];
+TTY* serial_tty = NULL;
+uint8_t serial_mode = SERIAL_OFF;
+
+static inline uint64_t terminal_all_rows() {
+    return (1ULL << terminal_height) - 1;
+}
+
+static inline uint16_t* tty_line(TTY* tty, size_t y) {
+    size_t r = tty->top + y;
+    if (r >= terminal_height) r -= terminal_height;
+    return tty->buffer[r];
+}
+
+static inline uint16_t* terminal_line(size_t y) {
+    return tty_line(terminal_tty, y);
+}
+
+static inline int terminal_tty_index() {
+    return terminal_tty - ttys;
+}
 
 bool shift_pressed = false;
 bool ctrl_pressed = false;
 bool alt_pressed = false;
 bool caps_lock = false;
+bool e0_prefix = false;
 
 Process processes[MAX_PROCESSES];
 int process_count = 0;
@@ -315,9 +699,11 @@ int current_process = 0;
 Pipe pipes[MAX_PIPES];
 int pipe_count = 0;
 
+Job jobs[MAX_JOBS];
+
 char command_history[HISTORY_SIZE][MAX_CMD_LEN];
 int history_count = 0;
-int history_pos = 0;
+int history_head = 0;
 
 bool mouse_enabled = false;
 int mouse_x = 40;
@@ -329,30 +715,48 @@ int selection_start_y = -1;
 int selection_end_x = -1;
 int selection_end_y = -1;
 
-void kernel_main();
+void kernel_main(uintptr_t multiboot_info);
 void kernel_panic(const char* message);
 void terminal_initialize();
 void move_cursor(size_t x, size_t y);
 void terminal_setcolor(uint8_t fg, uint8_t bg);
 void terminal_clear();
 void terminal_scroll();
+void terminal_flush();
 void terminal_putchar(char c);
 void terminal_write(const char* data, size_t size);
 void terminal_writestring(const char* data);
-void terminal_printf(const char* format, ...);
+void terminal_printf(const char* format, ...) __attribute__((format(printf, 1, 2)));
+int snprintf(char* buf, size_t size, const char* format, ...) __attribute__((format(printf, 3, 4)));
+void terminal_print_fixed2(uint32_t value_x100);
+int fs_lookup(uint32_t parent_inode, const char* name);
 void shell();
 void login_screen();
 void switch_tty(int tty_num);
 void save_tty_state();
 void restore_tty_state();
+void terminal_bind(TTY* tty);
+void task_yield();
+void fb_draw_row(size_t y, const uint16_t* cells);
+void fb_move_cursor(size_t x, size_t y);
+void fb_scroll();
+void serial_poll();
+void serial_write(const char* data, size_t size);
+int serial_getchar();
 void initialize_ttys();
 void execute_ps();
 void execute_jobs();
 void execute_kill(char* pid_str, char* sig_str);
 void klog(int level, const char* message);
+void klogf(int level, const char* format, ...) __attribute__((format(printf, 2, 3)));
+void klog_mirror();
 uint32_t sys_fork();
 void sys_exit(uint32_t status);
 void send_signal(uint32_t pid, uint32_t sig);
+void signal_group(uint32_t pgid, uint32_t sig);
+void job_claim_tty();
+void execute_command(char* cmd);
+void execute_script(const char* path);
  void mouse_wait(uint8_t type);
  void mouse_write(uint8_t data);
  uint8_t mouse_read();
@@ -366,9 +770,23 @@ void clear_selection();
 void execute_smouse();
 
 static int strcmp_case_insensitive(const char* s1, const char* s2) {
-    while (*s1 && *s2) {
+    while (1) {
+        if (str_word_safe(s1, s2)) {
+            uint64_t x = *(const mem_u64*)s1;
+            uint64_t y = *(const mem_u64*)s2;
+            uint64_t z = str_zero_bytes(x) | str_zero_bytes(y) | (str_lower(x) ^ str_lower(y));
+            if (z == 0) {
+                s1 += 8;
+                s2 += 8;
+                continue;
+            }
+            size_t k = __builtin_ctzll(z) / 8;
+            s1 += k;
+            s2 += k;
+        }
         char c1 = *s1;
         char c2 = *s2;
+        if (c1 == '\0' || c2 == '\0') break;
         if (c1 >= 'A' && c1 <= 'Z') c1 += 32;
         if (c2 >= 'A' && c2 <= 'Z') c2 += 32;
         if (c1 != c2) return c1 - c2;
@@ -378,32 +796,247 @@ static int strcmp_case_insensitive(const char* s1, const char* s2) {
     return *(const unsigned char*)s1 - *(const unsigned char*)s2;
 }
 
-static void int_to_str(int num, char* str) {
-    int i = 0;
-    int is_negative = 0;
-    if (num < 0) {
-        is_negative = 1;
-        num = -num;
-    } else if (num == 0) {
-        str[i++] = '0';
+typedef void (*print_sink)(void* ctx, const char* data, size_t size);
+
+typedef struct {
+    char* buf;
+    size_t size;
+    size_t pos;
+} BufferSink;
+
+struct Stream {
+    print_sink write;
+    void* ctx;
+};
+
+Stream* terminal_out = NULL;
+Pipe* terminal_in = NULL;
+
+static const char fmt_digits2[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static char* fmt_u64(char* end, uint64_t v) {
+    while (v >= 100) {
+        uint32_t r = (uint32_t)(v % 100) * 2;
+        v /= 100;
+        *--end = fmt_digits2[r + 1];
+        *--end = fmt_digits2[r];
+    }
+    if (v >= 10) {
+        *--end = fmt_digits2[v * 2 + 1];
+        *--end = fmt_digits2[v * 2];
+    } else {
+        *--end = '0' + v;
     }
-    while (num != 0) {
-        str[i++] = (num % 10) + '0';
-        num /= 10;
+    return end;
+}
+
+static char* fmt_hex(char* end, uint64_t v, bool upper) {
+    const char* digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    do {
+        *--end = digits[v & 0xF];
+        v >>= 4;
+    } while (v);
+    return end;
+}
+
+static void fmt_fill(print_sink sink, void* ctx, char c, int n) {
+    static const char spaces[] = "                ";
+    static const char zeros[] = "0000000000000000";
+    const char* chunk = c == '0' ? zeros : spaces;
+    while (n > 0) {
+        int k = n < 16 ? n : 16;
+        sink(ctx, chunk, k);
+        n -= k;
     }
-    if (is_negative) {
-        str[i++] = '-';
+}
+
+int kvprintf(print_sink sink, void* ctx, const char* format, va_list args) {
+    int total = 0;
+    while (*format) {
+        const char* run = format;
+        while (*format && *format != '%') format++;
+        if (format > run) {
+            sink(ctx, run, format - run);
+            total += format - run;
+        }
+        if (*format == '\0') break;
+        format++;
+
+        bool left = false;
+        bool plus = false;
+        bool space = false;
+        bool alt = false;
+        char pad = ' ';
+        for (;; format++) {
+            if (*format == '-') left = true;
+            else if (*format == '0') pad = '0';
+            else if (*format == '+') plus = true;
+            else if (*format == ' ') space = true;
+            else if (*format == '#') alt = true;
+            else break;
+        }
+        int width = 0;
+        if (*format == '*') {
+            width = va_arg(args, int);
+            if (width < 0) {
+                left = true;
+                width = -width;
+            }
+            format++;
+        } else {
+            while (*format >= '0' && *format <= '9') width = width * 10 + (*format++ - '0');
+        }
+        int precision = -1;
+        if (*format == '.') {
+            format++;
+            precision = 0;
+            if (*format == '*') {
+                precision = va_arg(args, int);
+                format++;
+            } else {
+                while (*format >= '0' && *format <= '9') precision = precision * 10 + (*format++ - '0');
+            }
+        }
+        int length = 0;
+        while (*format == 'h') {
+            length--;
+            format++;
+        }
+        if (*format == 'l') {
+            length = 1;
+            if (*++format == 'l') {
+                length = 2;
+                format++;
+            }
+        } else if (*format == 'z') {
+            length = 1;
+            format++;
+        }
+
+        char buf[24];
+        char* end = buf + sizeof(buf);
+        const char* str = end;
+        const char* prefix = "";
+        bool numeric = true;
+        uint64_t u;
+        switch (*format) {
+            case 'd':
+            case 'i': {
+                int64_t v = length >= 2 ? va_arg(args, long long) :
+                            length == 1 ? va_arg(args, long) : va_arg(args, int);
+                if (length == -1) v = (short)v;
+                else if (length <= -2) v = (signed char)v;
+                str = fmt_u64(end, v < 0 ? -(uint64_t)v : (uint64_t)v);
+                prefix = v < 0 ? "-" : plus ? "+" : space ? " " : "";
+                break;
+            }
+            case 'u':
+            case 'x':
+            case 'X':
+                u = length >= 2 ? va_arg(args, unsigned long long) :
+                    length == 1 ? va_arg(args, unsigned long) : va_arg(args, unsigned int);
+                if (length == -1) u = (unsigned short)u;
+                else if (length <= -2) u = (unsigned char)u;
+                if (*format == 'u') {
+                    str = fmt_u64(end, u);
+                } else {
+                    str = fmt_hex(end, u, *format == 'X');
+                    if (alt && u) prefix = *format == 'X' ? "0X" : "0x";
+                }
+                break;
+            case 'p':
+                str = fmt_hex(end, (uintptr_t)va_arg(args, void*), false);
+                prefix = "0x";
+                break;
+            case 'c':
+                *--end = (char)va_arg(args, int);
+                str = end;
+                end++;
+                numeric = false;
+                break;
+            case 's': {
+                str = va_arg(args, const char*);
+                if (str == NULL) str = "(null)";
+                size_t n = 0;
+                while (str[n] && (precision < 0 || n < (size_t)precision)) n++;
+                end = (char*)str + n;
+                numeric = false;
+                break;
+            }
+            case '%':
+                sink(ctx, "%", 1);
+                total++;
+                format++;
+                continue;
+            default:
+                if (*format == '\0') return total;
+                sink(ctx, format - 1, 2);
+                total += 2;
+                format++;
+                continue;
+        }
+        format++;
+
+        int len = end - str;
+        int plen = strlen(prefix);
+        int zeros = 0;
+        if (numeric && precision >= 0) {
+            if (precision > len) zeros = precision - len;
+            pad = ' ';
+        }
+        int fill = width - plen - zeros - len;
+        if (fill < 0) fill = 0;
+        if (left) pad = ' ';
+        if (!numeric && pad == '0') pad = ' ';
+        if (pad == '0') {
+            zeros += fill;
+            fill = 0;
+        }
+        if (!left) fmt_fill(sink, ctx, ' ', fill);
+        if (plen) sink(ctx, prefix, plen);
+        fmt_fill(sink, ctx, '0', zeros);
+        if (len) sink(ctx, str, len);
+        if (left) fmt_fill(sink, ctx, ' ', fill);
+        total += fill + plen + zeros + len;
     }
-    str[i] = '\0';
-    int start = 0;
-    int end = i - 1;
-    while (start < end) {
-        char tmp = str[start];
-        str[start] = str[end];
-        str[end] = tmp;
-        start++;
-        end--;
+    return total;
+}
+
+static void buffer_sink(void* ctx, const char* data, size_t size) {
+    BufferSink* b = ctx;
+    if (b->pos + 1 < b->size) {
+        size_t room = b->size - 1 - b->pos;
+        size_t n = size < room ? size : room;
+        memcpy(b->buf + b->pos, data, n);
     }
+    b->pos += size;
+}
+
+int vsnprintf(char* buf, size_t size, const char* format, va_list args) {
+    BufferSink b = {buf, size, 0};
+    int n = kvprintf(buffer_sink, &b, format, args);
+    if (size > 0) buf[b.pos < size ? b.pos : size - 1] = '\0';
+    return n;
+}
+
+int snprintf(char* buf, size_t size, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buf, size, format, args);
+    va_end(args);
+    return n;
+}
+
+static void int_to_str(int num, char* str) {
+    char buf[12];
+    char* end = buf + sizeof(buf);
+    char* p = fmt_u64(end, num < 0 ? -(int64_t)num : num);
+    if (num < 0) *str++ = '-';
+    while (p < end) *str++ = *p++;
+    *str = '\0';
 }
 
 
@@ -441,6 +1074,12 @@ static inline void io_wait() {
     outb(0x80, 0);
 }
 
+static inline uint64_t rdtsc() {
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
 bool is_valid_filename(const char* name) {
     const char* invalid_chars = "&;|*?'\"`[]()$<>{}^#\\/%!";
     if (strlen(name) == 0) return false;
@@ -454,12 +1093,7 @@ bool is_valid_filename(const char* name) {
 }
 
 bool file_exists_in_current_dir(const char* name) {
-    for (int i = 0; i < file_count; i++) {
-        if (files[i].parent_inode == current_inode && strcmp(files[i].name, name) == 0) {
-            return true;
-        }
-    }
-    return false;
+    return fs_lookup(current_inode, name) != -1;
 }
 
 void initialize_ttys() {
@@ -470,7 +1104,20 @@ void initialize_ttys() {
         ttys[i].input_pos = 0;
         ttys[i].current_inode = 1;
         ttys[i].logged_in = false;
-        memset(ttys[i].buffer, ' ', sizeof(ttys[i].buffer));
+        for (size_t y = 0; y < terminal_height; y++) {
+            for (size_t x = 0; x < terminal_width; x++) {
+                ttys[i].buffer[y][x] = ' ' | (ttys[i].color << 8);
+            }
+        }
+        ttys[i].top = 0;
+        ttys[i].dirty = 0;
+        ttys[i].scrollback = NULL;
+        ttys[i].scrollback_head = 0;
+        ttys[i].scrollback_count = 0;
+        ttys[i].scrollback_view = 0;
+        ttys[i].fg_pgid = 0;
+        ttys[i].interrupted = false;
+        ttys[i].typeahead_len = 0;
     }
     current_tty = 0;
 }
@@ -479,56 +1126,58 @@ bool smouse_mode = false;
 uint32_t last_smouse_clear = 0;
 
 void save_tty_state() {
-    TTY* tty = &ttys[current_tty];
+    TTY* tty = terminal_tty;
     tty->row = terminal_row;
     tty->column = terminal_column;
     tty->color = terminal_color;
     tty->current_inode = current_inode;
-    for (size_t y = 0; y < SCREEN_HEIGHT; y++) {
-        for (size_t x = 0; x < SCREEN_WIDTH; x++) {
-            tty->buffer[y][x] = terminal_buffer[y * SCREEN_WIDTH + x];
-        }
-    }
 }
 
 void restore_tty_state() {
-    TTY* tty = &ttys[current_tty];
+    TTY* tty = terminal_tty;
     terminal_row = tty->row;
     terminal_column = tty->column;
     terminal_color = tty->color;
     current_inode = tty->current_inode;
-    for (size_t y = 0; y < SCREEN_HEIGHT; y++) {
-        for (size_t x = 0; x < SCREEN_WIDTH; x++) {
-            terminal_buffer[y * SCREEN_WIDTH + x] = tty->buffer[y][x];
-        }
-    }
-    move_cursor(terminal_column, terminal_row);
+}
+
+void terminal_bind(TTY* tty) {
+    if (tty == terminal_tty) return;
+    save_tty_state();
+    terminal_tty = tty;
+    restore_tty_state();
 }
 
 void switch_tty(int tty_num) {
     if (smouse_mode) return;
 
-    if (tty_num < 0 || tty_num >= MAX_TTYS) return;
-    save_tty_state();
+    if (tty_num < 0 || tty_num >= MAX_TTYS || tty_num == current_tty) return;
+    TTY* self = terminal_tty;
     current_tty = tty_num;
-    restore_tty_state();
-    if (!ttys[current_tty].logged_in) {
-        login_screen();
-    }
+    terminal_bind(&ttys[tty_num]);
+    terminal_tty->dirty = terminal_all_rows();
+    terminal_flush();
+    terminal_bind(self);
 }
 
 void terminal_initialize() {
+    terminal_buffer = VIDEO_MEMORY;
+    initialize_ttys();
+    terminal_tty = &ttys[0];
     terminal_row = 0;
     terminal_column = 0;
-    terminal_color = (COLOR_BLACK << 4) | COLOR_WHITE;
-    terminal_buffer = VIDEO_MEMORY;
     terminal_setcolor(COLOR_WHITE, COLOR_BLACK);
     terminal_clear();
-    initialize_ttys();
 }
 
 void move_cursor(size_t x, size_t y) {
-    uint16_t pos = y * SCREEN_WIDTH + x;
+    if (fb_console) {
+        fb_move_cursor(x, y);
+        return;
+    }
+    uint16_t pos = terminal_origin + y * terminal_width + x;
+    if (pos == terminal_cursor) return;
+    terminal_cursor = pos;
     outb(0x3D4, 0x0F);
     outb(0x3D5, (uint8_t)(pos & 0xFF));
     outb(0x3D4, 0x0E);
@@ -537,76 +1186,222 @@ void move_cursor(size_t x, size_t y) {
 
 void terminal_setcolor(uint8_t fg, uint8_t bg) {
     terminal_color = (bg << 4) | (fg & 0x0F);
-    ttys[current_tty].color = terminal_color;
+    terminal_tty->color = terminal_color;
+}
+
+static inline void terminal_set_cell(size_t x, size_t y, uint16_t cell) {
+    terminal_line(y)[x] = cell;
+    terminal_tty->dirty |= 1ULL << y;
+}
+
+void terminal_scrollback_push(TTY* tty, const uint16_t* line) {
+    if (tty->scrollback == NULL) {
+        tty->scrollback = malloc(SCROLLBACK_LINES * terminal_width * sizeof(uint16_t));
+        if (tty->scrollback == NULL) return;
+    }
+    memcpy(&tty->scrollback[tty->scrollback_head * terminal_width], line, terminal_width * sizeof(uint16_t));
+    tty->scrollback_head = tty->scrollback_head + 1 < SCROLLBACK_LINES ? tty->scrollback_head + 1 : 0;
+    if (tty->scrollback_count < SCROLLBACK_LINES) tty->scrollback_count++;
+}
+
+static void terminal_present_row(size_t y, const uint16_t* src) {
+    if (fb_console) {
+        fb_draw_row(y, src);
+        return;
+    }
+    volatile uint64_t* dst = (volatile uint64_t*)&terminal_buffer[terminal_origin + y * terminal_width];
+    for (size_t i = 0; i < terminal_width / 4; i++) {
+        dst[i] = ((const uint64_t*)src)[i];
+    }
+}
+
+void terminal_flush() {
+    TTY* tty = terminal_tty;
+    if (tty != &ttys[current_tty]) return;
+    if (tty->scrollback_view != 0) {
+        tty->scrollback_view = 0;
+        tty->dirty = terminal_all_rows();
+    }
+    uint64_t dirty = tty->dirty;
+    tty->dirty = 0;
+    while (dirty) {
+        uint32_t y = __builtin_ctzll(dirty);
+        dirty &= dirty - 1;
+        terminal_present_row(y, terminal_line(y));
+    }
+    if (!fb_console && terminal_origin != terminal_crtc_start) {
+        terminal_crtc_start = terminal_origin;
+        outb(0x3D4, 0x0C);
+        outb(0x3D5, (uint8_t)(terminal_origin >> 8));
+        outb(0x3D4, 0x0D);
+        outb(0x3D5, (uint8_t)(terminal_origin & 0xFF));
+    }
+    move_cursor(terminal_column, terminal_row);
+}
+
+void terminal_scrollback(int lines) {
+    TTY* tty = &ttys[current_tty];
+    int32_t view = (int32_t)tty->scrollback_view + lines;
+    if (view < 0) view = 0;
+    if ((uint32_t)view > tty->scrollback_count) view = tty->scrollback_count;
+    if ((uint32_t)view == tty->scrollback_view) return;
+    tty->scrollback_view = view;
+    if (view == 0) {
+        tty->dirty = terminal_all_rows();
+        terminal_flush();
+        return;
+    }
+    for (size_t y = 0; y < terminal_height; y++) {
+        const uint16_t* src;
+        if (y < (uint32_t)view) {
+            uint32_t idx = (tty->scrollback_head + SCROLLBACK_LINES - view + y) % SCROLLBACK_LINES;
+            src = &tty->scrollback[idx * terminal_width];
+        } else {
+            src = tty_line(tty, y - view);
+        }
+        terminal_present_row(y, src);
+    }
+    move_cursor(0, terminal_height);
 }
 
 void terminal_clear() {
-    for (size_t y = 0; y < SCREEN_HEIGHT; y++) {
-        for (size_t x = 0; x < SCREEN_WIDTH; x++) {
-            terminal_buffer[y * SCREEN_WIDTH + x] = ' ' | (terminal_color << 8);
+    TTY* tty = terminal_tty;
+    uint16_t blank = ' ' | (terminal_color << 8);
+    for (size_t y = 0; y < terminal_height; y++) {
+        for (size_t x = 0; x < terminal_width; x++) {
+            tty->buffer[y][x] = blank;
         }
     }
+    tty->top = 0;
+    tty->dirty = terminal_all_rows();
     terminal_row = 0;
     terminal_column = 0;
-    move_cursor(0, 0);
+    terminal_flush();
 }
 
 void terminal_scroll() {
-    for (size_t y = 1; y < SCREEN_HEIGHT; y++) {
-        for (size_t x = 0; x < SCREEN_WIDTH; x++) {
-            terminal_buffer[(y-1)*SCREEN_WIDTH + x] = terminal_buffer[y*SCREEN_WIDTH + x];
-        }
+    TTY* tty = terminal_tty;
+    terminal_scrollback_push(tty, terminal_line(0));
+    tty->top = tty->top + 1 < terminal_height ? tty->top + 1 : 0;
+    uint16_t* line = terminal_line(terminal_height - 1);
+    for (size_t x = 0; x < terminal_width; x++) {
+        line[x] = ' ' | (terminal_color << 8);
     }
-    for (size_t x = 0; x < SCREEN_WIDTH; x++) {
-        terminal_buffer[(SCREEN_HEIGHT-1)*SCREEN_WIDTH + x] = ' ' | (terminal_color << 8);
+    if (tty != &ttys[current_tty]) {
+        tty->dirty = terminal_all_rows();
+    } else if (fb_console) {
+        tty->dirty = (tty->dirty >> 1) | (1ULL << (terminal_height - 1));
+        fb_scroll();
+    } else if (terminal_origin + terminal_width + terminal_height * terminal_width > VGA_TEXT_CELLS) {
+        terminal_origin = 0;
+        tty->dirty = terminal_all_rows();
+    } else {
+        terminal_origin += terminal_width;
+        tty->dirty = (tty->dirty >> 1) | (1ULL << (terminal_height - 1));
     }
-    terminal_row = SCREEN_HEIGHT - 1;
+    terminal_row = terminal_height - 1;
     terminal_column = 0;
 }
 
-void terminal_putchar(char c) {
-    if (smouse_mode) return;
-
+static __attribute__((noinline)) void terminal_emit(char c) {
     if (c == '\n') {
         terminal_column = 0;
-        if (++terminal_row == SCREEN_HEIGHT) {
+        if (++terminal_row == terminal_height) {
             terminal_scroll();
         }
     } else if (c == '\b') {
         if (terminal_column > 0) {
             terminal_column--;
-            terminal_buffer[terminal_row * SCREEN_WIDTH + terminal_column] = ' ' | (terminal_color << 8);
+            terminal_set_cell(terminal_column, terminal_row, ' ' | (terminal_color << 8));
         } else if (terminal_row > 0) {
             terminal_row--;
-            terminal_column = SCREEN_WIDTH - 1;
-            terminal_buffer[terminal_row * SCREEN_WIDTH + terminal_column] = ' ' | (terminal_color << 8);
+            terminal_column = terminal_width - 1;
+            terminal_set_cell(terminal_column, terminal_row, ' ' | (terminal_color << 8));
         }
     } else {
-        terminal_buffer[terminal_row * SCREEN_WIDTH + terminal_column] = c | (terminal_color << 8);
-        if (++terminal_column == SCREEN_WIDTH) {
+        terminal_set_cell(terminal_column, terminal_row, (uint8_t)c | (terminal_color << 8));
+        if (++terminal_column == terminal_width) {
             terminal_column = 0;
-            if (++terminal_row == SCREEN_HEIGHT) {
+            if (++terminal_row == terminal_height) {
                 terminal_scroll();
             }
         }
     }
-    move_cursor(terminal_column, terminal_row);
 }
 
-void terminal_write(const char* data, size_t size) {
+static bool terminal_serial(const char* data, size_t size) {
+    serial_write(data, size);
+    return serial_mode == SERIAL_REDIRECT;
+}
+
+void terminal_putchar(char c) {
     if (smouse_mode) return;
+    if (terminal_out != NULL) {
+        terminal_out->write(terminal_out->ctx, &c, 1);
+        return;
+    }
+    if (terminal_tty == serial_tty && terminal_serial(&c, 1)) return;
 
+    terminal_emit(c);
+    terminal_flush();
+    if (c == '\n') task_yield();
+}
+
+static void terminal_put(const char* data, size_t size) {
+    if (terminal_out != NULL) {
+        terminal_out->write(terminal_out->ctx, data, size);
+        return;
+    }
+    if (terminal_tty == serial_tty && terminal_serial(data, size)) return;
     for (size_t i = 0; i < size; i++) {
-        terminal_putchar(data[i]);
+        terminal_emit(data[i]);
     }
 }
 
+void terminal_write(const char* data, size_t size) {
+    if (smouse_mode) return;
+
+    terminal_put(data, size);
+    terminal_flush();
+    task_yield();
+}
+
+void terminal_cursor_back(size_t n) {
+    if (smouse_mode || terminal_out != NULL || n == 0) return;
+    if (terminal_tty == serial_tty) {
+        for (size_t i = 0; i < n; i++) serial_write("\b", 1);
+        if (serial_mode == SERIAL_REDIRECT) return;
+    }
+    while (n-- > 0) {
+        if (terminal_column > 0) {
+            terminal_column--;
+        } else if (terminal_row > 0) {
+            terminal_row--;
+            terminal_column = terminal_width - 1;
+        }
+    }
+    terminal_flush();
+}
+
 void terminal_writestring(const char* data) {
     if (smouse_mode) return;
+    if (terminal_out != NULL) {
+        terminal_out->write(terminal_out->ctx, data, strlen(data));
+        task_yield();
+        return;
+    }
+    if (terminal_tty == serial_tty && terminal_serial(data, strlen(data))) return;
 
     while (*data) {
-        terminal_putchar(*data++);
+        terminal_emit(*data++);
     }
+    terminal_flush();
+    task_yield();
+}
+
+static void terminal_sink(void* ctx, const char* data, size_t size) {
+    (void)ctx;
+    terminal_put(data, size);
 }
 
 void terminal_printf(const char* format, ...) {
@@ -614,55 +1409,14 @@ void terminal_printf(const char* format, ...) {
 
     va_list args;
     va_start(args, format);
-    char buffer[256];
-    char *ptr = buffer;
-    while (*format) {
-        if (*format == '%') {
-            format++;
-            switch (*format) {
-                case 'd': {
-                    int num = va_arg(args, int);
-                    char num_str[16];
-                    int_to_str(num, num_str);
-                    char *tmp = num_str;
-                    while (*tmp) {
-                        *ptr++ = *tmp++;
-                    }
-                    break;
-                }
-                case 's': {
-                    char *str = va_arg(args, char*);
-                    while (*str) {
-                        *ptr++ = *str++;
-                    }
-                    break;
-                }
-                case 'c': {
-                    char c = (char)va_arg(args, int);
-                    *ptr++ = c;
-                    break;
-                }
-                case 'x': {
-                    uint32_t num = va_arg(args, uint32_t);
-                    const char* hex = "0123456789ABCDEF";
-                    for (int i = 7; i >= 0; i--) {
-                        *ptr++ = hex[(num >> (i * 4)) & 0xF];
-                    }
-                    break;
-                }
-                case '%': {
-                    *ptr++ = '%';
-                    break;
-                }
-            }
-        } else {
-            *ptr++ = *format;
-        }
-        format++;
-    }
-    *ptr = '\0';
-    terminal_writestring(buffer);
+    kvprintf(terminal_sink, NULL, format, args);
     va_end(args);
+    terminal_flush();
+    task_yield();
+}
+
+void terminal_print_fixed2(uint32_t value_x100) {
+    terminal_printf("%u.%02u", value_x100 / 100, value_x100 % 100);
 }
 
 uint8_t cmos_read(uint8_t reg) {
@@ -731,9 +1485,9 @@ void mouse_handler() {
             mouse_y += dy / 2;
 
             if (mouse_x < 0) mouse_x = 0;
-            if (mouse_x >= SCREEN_WIDTH) mouse_x = SCREEN_WIDTH - 1;
+            if (mouse_x >= (int)terminal_width) mouse_x = terminal_width - 1;
             if (mouse_y < 0) mouse_y = 0;
-            if (mouse_y >= SCREEN_HEIGHT) mouse_y = SCREEN_HEIGHT - 1;
+            if (mouse_y >= (int)terminal_height) mouse_y = terminal_height - 1;
 
             if (mouse_left_pressed) {
                 if (selection_start_x == -1) {
@@ -782,17 +1536,15 @@ void init_mouse() {
 void draw_mouse() {
     if (!mouse_enabled) return;
 
-    uint16_t pos = mouse_y * SCREEN_WIDTH + mouse_x;
-    uint16_t attr = terminal_buffer[pos];
-    terminal_buffer[pos] = 0xDB | (COLOR_WHITE << 8);
+    terminal_set_cell(mouse_x, mouse_y, 0xDB | (COLOR_WHITE << 8));
+    terminal_flush();
 }
 
 void clear_mouse() {
     if (!mouse_enabled) return;
 
-    uint16_t pos = mouse_y * SCREEN_WIDTH + mouse_x;
-    uint16_t attr = terminal_buffer[pos];
-    terminal_buffer[pos] = attr;
+    terminal_set_cell(mouse_x, mouse_y, terminal_line(mouse_y)[mouse_x]);
+    terminal_flush();
 }
 
 void update_selection() {
@@ -811,12 +1563,12 @@ void draw_selection() {
     int end_y = selection_start_y < selection_end_y ? selection_end_y : selection_start_y;
 
     for (int y = start_y; y <= end_y; y++) {
-        for (int x = (y == start_y ? start_x : 0); x <= (y == end_y ? end_x : SCREEN_WIDTH - 1); x++) {
-            uint16_t pos = y * SCREEN_WIDTH + x;
-            uint16_t attr = terminal_buffer[pos];
-            terminal_buffer[pos] = (attr & 0xFF) | ((COLOR_BLACK << 4) | COLOR_WHITE) << 8;
+        for (int x = (y == start_y ? start_x : 0); x <= (y == end_y ? end_x : (int)terminal_width - 1); x++) {
+            uint16_t attr = terminal_line(y)[x];
+            terminal_set_cell(x, y, (attr & 0xFF) | ((COLOR_BLACK << 4) | COLOR_WHITE) << 8);
         }
     }
+    terminal_flush();
 }
 
 void clear_selection() {
@@ -828,12 +1580,12 @@ void clear_selection() {
     int end_y = selection_start_y < selection_end_y ? selection_end_y : selection_start_y;
 
     for (int y = start_y; y <= end_y; y++) {
-        for (int x = (y == start_y ? start_x : 0); x <= (y == end_y ? end_x : SCREEN_WIDTH - 1); x++) {
-            uint16_t pos = y * SCREEN_WIDTH + x;
-            uint16_t attr = terminal_buffer[pos];
-            terminal_buffer[pos] = (attr & 0xFF) | (terminal_color << 8);
+        for (int x = (y == start_y ? start_x : 0); x <= (y == end_y ? end_x : (int)terminal_width - 1); x++) {
+            uint16_t attr = terminal_line(y)[x];
+            terminal_set_cell(x, y, (attr & 0xFF) | (terminal_color << 8));
         }
     }
+    terminal_flush();
 }
 
 void execute_smouse() {
@@ -863,6 +1615,147 @@ void execute_smouse() {
     }
 }
 
+static int keyboard_scan() {
+    klog_mirror();
+    serial_poll();
+    if (terminal_tty == serial_tty) {
+        int c = serial_getchar();
+        if (c >= 0) return c;
+    }
+    if (terminal_tty != &ttys[current_tty]) return -1;
+    if (inb(0x64) & 0x01) {
+        uint8_t scancode = inb(0x60);
+        if (scancode == 0xE0) {
+            e0_prefix = true;
+            return -1;
+        }
+        if (e0_prefix) {
+            e0_prefix = false;
+            if (scancode & 0x80) {
+                if ((scancode & 0x7F) == KEY_CTRL) ctrl_pressed = false;
+                else if ((scancode & 0x7F) == KEY_ALT) alt_pressed = false;
+                return -1;
+            }
+            switch(scancode) {
+                case KEY_CTRL:  ctrl_pressed = true; return -1;
+                case KEY_ALT:   alt_pressed = true; return -1;
+                case KEY_UP:    return (uint8_t)CHAR_UP;
+                case KEY_DOWN:  return (uint8_t)CHAR_DOWN;
+                case KEY_LEFT:  return (uint8_t)CHAR_LEFT;
+                case KEY_RIGHT: return (uint8_t)CHAR_RIGHT;
+                case KEY_HOME:  return (uint8_t)CHAR_HOME;
+                case KEY_END:   return (uint8_t)CHAR_END;
+                case KEY_DELETE: return (uint8_t)CHAR_DELETE;
+                case KEY_ENTER: return '\n';
+                case KEY_PGUP:
+                    if (shift_pressed) terminal_scrollback(terminal_height - 1);
+                    return -1;
+                case KEY_PGDN:
+                    if (shift_pressed) terminal_scrollback(-(terminal_height - 1));
+                    return -1;
+            }
+            return -1;
+        }
+        if (scancode & 0x80) {
+            uint8_t released_key = scancode & 0x7F;
+            if (released_key == KEY_LSHIFT || released_key == KEY_RSHIFT) {
+                shift_pressed = false;
+            } else if (released_key == KEY_CTRL) {
+                ctrl_pressed = false;
+            } else if (released_key == KEY_ALT) {
+                alt_pressed = false;
+            }
+            return -1;
+        }
+        if (scancode == KEY_LSHIFT || scancode == KEY_RSHIFT) {
+            shift_pressed = true;
+            return -1;
+        } else if (scancode == KEY_CTRL) {
+            ctrl_pressed = true;
+            return -1;
+        } else if (scancode == KEY_ALT) {
+            alt_pressed = true;
+            return -1;
+        } else if (scancode == KEY_CAPSLOCK) {
+            caps_lock = !caps_lock;
+            return -1;
+        }
+        if (scancode == KEY_ENTER) return '\n';
+        if (scancode == KEY_BACKSPACE) return '\b';
+        if (scancode == KEY_TAB) return '\t';
+        if (scancode == KEY_ESC) return '\x1B';
+        if (scancode == KEY_SPACE) return ' ';
+        if (scancode == KEY_F1) { switch_tty(0); return -1; }
+        if (scancode == KEY_F2) { switch_tty(1); return -1; }
+        if (scancode == KEY_F3) { switch_tty(2); return -1; }
+        if (scancode == KEY_F4) { switch_tty(3); return -1; }
+        if (scancode == KEY_F5) { switch_tty(4); return -1; }
+        if (scancode == KEY_F6) { switch_tty(5); return -1; }
+        if (scancode == KEY_F7) { switch_tty(6); return -1; }
+        if (scancode == KEY_F8) { switch_tty(7); return -1; }
+        if (scancode == KEY_F9) { switch_tty(8); return -1; }
+        if (scancode == KEY_F10) return 0xFA;
+        static const char keyboard_map_lower[] = "\x00\x1B" "1234567890-=" "\x08"
+            "\x00" "qwertyuiop[]" "\x0D" "\x00" "asdfghjkl;'`" "\x00"
+            "\\zxcvbnm,./" "\x00\x00\x00" " ";
+        static const char keyboard_map_upper[] = "\x00\x1B" "!@#$%^&*()_+" "\x08"
+            "\x00" "QWERTYUIOP{}" "\x0D" "\x00" "ASDFGHJKL:\"~" "\x00"
+            "|ZXCVBNM<>?" "\x00\x00\x00" " ";
+        _Static_assert(sizeof(keyboard_map_lower) == sizeof(keyboard_map_upper), "keyboard maps differ in length");
+        if (scancode < sizeof(keyboard_map_lower) - 1) {
+            bool uppercase = (shift_pressed != caps_lock);
+            if (ctrl_pressed) {
+                char key = keyboard_map_lower[scancode];
+                if (key >= 'a' && key <= 'z') return key - 'a' + 1;
+                return -1;
+            }
+            if (alt_pressed) {
+                return -1;
+            }
+            if (uppercase && keyboard_map_upper[scancode]) {
+                return keyboard_map_upper[scancode];
+            } else if (!uppercase && keyboard_map_lower[scancode]) {
+                return keyboard_map_lower[scancode];
+            }
+        }
+    }
+
+    if (mouse_enabled && (inb(0x64) & 1)) {
+        uint8_t data = inb(0x60);
+        mouse_handler();
+        clear_mouse();
+        draw_mouse();
+        update_selection();
+    }
+    return -1;
+}
+
+static int keyboard_signal(int c) {
+    if (c == '\x03') terminal_tty->interrupted = true;
+    if ((c == '\x03' || c == '\x1A') && terminal_tty->fg_pgid != 0) {
+        signal_group(terminal_tty->fg_pgid, c == '\x03' ? SIGINT : SIGSTOP);
+        return -1;
+    }
+    return c;
+}
+
+void keyboard_typeahead() {
+    TTY* tty = terminal_tty;
+    int c = keyboard_signal(keyboard_scan());
+    if (c < 0 || c == '\x03' || c == '\x1A') return;
+    if (tty->typeahead_len < sizeof(tty->typeahead)) tty->typeahead[tty->typeahead_len++] = c;
+}
+
+int keyboard_poll() {
+    TTY* tty = terminal_tty;
+    if (tty->typeahead_len > 0) {
+        int c = (uint8_t)tty->typeahead[0];
+        memmove(tty->typeahead, tty->typeahead + 1, --tty->typeahead_len);
+        return c;
+    }
+    return keyboard_signal(keyboard_scan());
+}
+
 char keyboard_getchar() {
     if (smouse_mode) {
         while (1) {
@@ -877,87 +1770,8 @@ char keyboard_getchar() {
         }
     }
 
-    while (1) {
-        if (inb(0x64) & 0x01) {
-            uint8_t scancode = inb(0x60);
-            if (scancode & 0x80) {
-                uint8_t released_key = scancode & 0x7F;
-                if (released_key == KEY_LSHIFT || released_key == KEY_RSHIFT) {
-                    shift_pressed = false;
-                } else if (released_key == KEY_CTRL) {
-                    ctrl_pressed = false;
-                } else if (released_key == KEY_ALT) {
-                    alt_pressed = false;
-                }
-                continue;
-            }
-            if (scancode == KEY_LSHIFT || scancode == KEY_RSHIFT) {
-                shift_pressed = true;
-                continue;
-            } else if (scancode == KEY_CTRL) {
-                ctrl_pressed = true;
-                continue;
-            } else if (scancode == KEY_ALT) {
-                alt_pressed = true;
-                continue;
-            } else if (scancode == KEY_CAPSLOCK) {
-                caps_lock = !caps_lock;
-                continue;
-            }
-            if (scancode == 0xE0) {
-                scancode = inb(0x60);
-                switch(scancode) {
-                    case KEY_UP:    return '\x11';
-                    case KEY_DOWN:  return '\x12';
-                    case KEY_LEFT:  return '\x13';
-                    case KEY_RIGHT: return '\x14';
-                }
-            }
-            if (scancode == KEY_ENTER) return '\n';
-            if (scancode == KEY_BACKSPACE) return '\b';
-            if (scancode == KEY_ESC) return '\x1B';
-            if (scancode == KEY_SPACE) return ' ';
-            if (scancode == KEY_F1) { switch_tty(0); continue; }
-            if (scancode == KEY_F2) { switch_tty(1); continue; }
-            if (scancode == KEY_F3) { switch_tty(2); continue; }
-            if (scancode == KEY_F4) { switch_tty(3); continue; }
-            if (scancode == KEY_F5) { switch_tty(4); continue; }
-            if (scancode == KEY_F6) { switch_tty(5); continue; }
-            if (scancode == KEY_F7) { switch_tty(6); continue; }
-            if (scancode == KEY_F8) { switch_tty(7); continue; }
-            if (scancode == KEY_F9) { switch_tty(8); continue; }
-            if (scancode == KEY_F10) return '\xFA';
-            if (scancode < 0x80) {
-                const char* keyboard_map_lower = "\x00\x1B" "1234567890-=" "\x08"
-                    "\x00" "qwertyuiop[]" "\x0D" "\x00" "asdfghjkl;'`" "\x00"
-                    "\\zxcvbnm,./" "\x00\x00\x00" " ";
-                const char* keyboard_map_upper = "\x00\x1B" "!@#$%^&*()_+" "\x08"
-                    "\x00" "QWERTYUIOP{}" "\x0D" "\x00" "ASDFGHJKL:\"~" "\x00"
-                    "|ZXCVBNM<>?" "\x00\x00\x00" " ";
-                bool uppercase = (shift_pressed != caps_lock);
-                if (ctrl_pressed) {
-                    if (scancode >= 0x10 && scancode <= 0x1C) {
-                        return scancode - 0x10 + 1;
-                    }
-                    continue;
-                }
-                if (alt_pressed) {
-                    continue;
-                }
-                if (uppercase && keyboard_map_upper[scancode]) {
-                    return keyboard_map_upper[scancode];
-                } else if (!uppercase && keyboard_map_lower[scancode]) {
-                    return keyboard_map_lower[scancode];
-                }
-            }
-        }
-
-        if (mouse_enabled && (inb(0x64) & 1)) {
-            uint8_t data = inb(0x60);
-            mouse_handler();
-            clear_mouse();
-            draw_mouse();
-            update_selection();
-        }
-    }
+    job_claim_tty();
+    int c;
+    while ((c = keyboard_poll()) < 0) task_yield();
+    return c;
 }
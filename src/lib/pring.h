@@ -4,6 +4,13 @@
 #include <stdarg.h>
 
 #define COM1 0x3F8
+#define SERIAL_BAUD_DIVISOR 1
+#define SERIAL_FIFO_SIZE 16
+#define SERIAL_TX_RING 8192
+#define SERIAL_RX_RING 256
+#define SERIAL_OFF      0
+#define SERIAL_MIRROR   1
+#define SERIAL_REDIRECT 2
 #define VIDEO_MEMORY ((volatile uint16_t*)0xB8000)
 #define COLOR_BLACK   0x0
 #define COLOR_BLUE    0x1
@@ -23,23 +30,51 @@
 #define COLOR_WHITE   0xF
 #define SCREEN_WIDTH 80
 #define SCREEN_HEIGHT 25
+#define VGA_TEXT_CELLS 16384
+#define TERM_MAX_WIDTH 160
+#define TERM_MAX_HEIGHT 60
+#define FB_CACHE_PAIRS 8
+#ifndef SCROLLBACK_LINES
+#define SCROLLBACK_LINES 1000
+#endif
 #define MAX_CMD_LEN 256
 #define PIT_FREQUENCY 1193182
 #define PIT_CHANNEL0 0x40
 #define PIT_COMMAND 0x43
 #define CMOS_ADDRESS 0x70
 #define CMOS_DATA 0x71
-#define MAX_FILES 128
 #define MAX_PROCESSES 16
+#define TASK_STACK_SIZE (64 * 1024)
+#define PROC_RUNNING 0
+#define PROC_STOPPED 1
+#define PROC_ZOMBIE  2
+#define MAX_JOBS 8
+#define BUILTIN_SHELL 0x01
+#define BUILTIN_BARE  0x02
+#define BUILTIN_CALL(name, fn) \
+    static void name(char** args, int arg_count) { (void)args; (void)arg_count; fn(); }
+#define SCRIPT_DEPTH_MAX 8
 #define SECTOR_SIZE 512
 #define MAX_PATH_LEN 256
-#define TOTAL_MEMORY_KB 640
-#define MAX_BLOCKS 1024
-#define MAX_INODES 128
+#define TOTAL_MEMORY_KB 32768
+#define IDENTITY_MAP_LIMIT 0x40000000
+#define MULTIBOOT_INFO_MEMORY 0x00000001
+#define MULTIBOOT_INFO_FRAMEBUFFER 0x00001000
+#define MULTIBOOT_FRAMEBUFFER_RGB 1
 #define BLOCK_SIZE 1024
 #define INODE_DIRECT_BLOCKS 12
+#define BKFS_CLUSTER_BLOCKS 4
+#define BKFS_CLUSTER_SIZE (BKFS_CLUSTER_BLOCKS * BLOCK_SIZE)
+#define BKFS_CLUSTERS (INODE_DIRECT_BLOCKS / BKFS_CLUSTER_BLOCKS)
+#define BKFS_COMPR_FL 0x00000004
+#define BKFS_HOLE 0
+#define BKFS_MEM_PERCENT 50
+#define BKFS_BLOCKS_PER_INODE 2
+#define BKFS_MIN_BLOCKS 1024
+#define BKFS_MIN_INODES 128
 #define MAX_TTYS 9
 #define MAX_PIPES 10
+#define PIPE_BUF_SIZE 1024
 #define HISTORY_SIZE 100
 #define KEY_ENTER     0x1C
 #define KEY_BACKSPACE 0x0E
@@ -48,6 +83,12 @@
 #define KEY_DOWN      0x50
 #define KEY_LEFT      0x4B
 #define KEY_RIGHT     0x4D
+#define KEY_PGUP      0x49
+#define KEY_PGDN      0x51
+#define KEY_HOME      0x47
+#define KEY_END       0x4F
+#define KEY_DELETE    0x53
+#define KEY_TAB       0x0F
 #define KEY_LSHIFT    0x2A
 #define KEY_RSHIFT    0x36
 #define KEY_CTRL      0x1D
@@ -64,6 +105,13 @@
 #define KEY_F8        0x42
 #define KEY_F9        0x43
 #define KEY_F10       0x44
+#define CHAR_UP    '\xF1'
+#define CHAR_DOWN  '\xF2'
+#define CHAR_LEFT  '\xF3'
+#define CHAR_RIGHT '\xF4'
+#define CHAR_HOME  '\xF5'
+#define CHAR_END   '\xF6'
+#define CHAR_DELETE '\xF7'
 #define FILE_REGULAR 0
 #define FILE_DIR     1
 #define FILE_SYMLINK 2
@@ -73,6 +121,9 @@
 #define LOG_LEVEL_INFO  1
 #define LOG_LEVEL_WARN  2
 #define LOG_LEVEL_ERROR 3
+#define KLOG_ENTRIES 1024
+#define KLOG_MSG_LEN 48
+#define KLOG_ARGS 5
 #define SIGINT  2
 #define SIGKILL 9
 #define SIGSTOP 19
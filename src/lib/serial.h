@@ -0,0 +1,82 @@
+#include "pring.h"
+#include <stddef.h>
+
+uint8_t serial_tx[SERIAL_TX_RING];
+uint32_t serial_tx_head = 0;
+uint32_t serial_tx_tail = 0;
+uint8_t serial_rx[SERIAL_RX_RING];
+uint32_t serial_rx_head = 0;
+uint32_t serial_rx_tail = 0;
+bool serial_present = false;
+uint32_t serial_fifo_depth = 1;
+uint32_t serial_tx_bytes = 0;
+uint32_t serial_rx_bytes = 0;
+uint32_t serial_dropped = 0;
+uint32_t serial_rx_dropped = 0;
+
+bool serial_init() {
+    outb(COM1 + 1, 0x00);
+    outb(COM1 + 7, 0xA5);
+    if (inb(COM1 + 7) != 0xA5) return false;
+    outb(COM1 + 3, 0x80);
+    outb(COM1 + 0, SERIAL_BAUD_DIVISOR & 0xFF);
+    outb(COM1 + 1, SERIAL_BAUD_DIVISOR >> 8);
+    outb(COM1 + 3, 0x03);
+    outb(COM1 + 2, 0xC7);
+    outb(COM1 + 4, 0x03);
+    serial_fifo_depth = (inb(COM1 + 2) & 0xC0) == 0xC0 ? SERIAL_FIFO_SIZE : 1;
+    serial_present = true;
+    return true;
+}
+
+void serial_poll() {
+    if (!serial_present) return;
+    uint8_t lsr = inb(COM1 + 5);
+    while (lsr & 0x01) {
+        uint8_t c = inb(COM1);
+        serial_rx_bytes++;
+        if (serial_rx_head - serial_rx_tail < SERIAL_RX_RING) {
+            serial_rx[serial_rx_head++ & (SERIAL_RX_RING - 1)] = c;
+        } else {
+            serial_rx_dropped++;
+        }
+        lsr = inb(COM1 + 5);
+    }
+    if (lsr & 0x20) {
+        for (uint32_t i = 0; i < serial_fifo_depth && serial_tx_tail != serial_tx_head; i++) {
+            outb(COM1, serial_tx[serial_tx_tail++ & (SERIAL_TX_RING - 1)]);
+        }
+    }
+}
+
+static inline void serial_put(uint8_t c) {
+    if (serial_tx_head - serial_tx_tail >= SERIAL_TX_RING) serial_poll();
+    if (serial_tx_head - serial_tx_tail >= SERIAL_TX_RING) {
+        serial_dropped++;
+        return;
+    }
+    serial_tx[serial_tx_head++ & (SERIAL_TX_RING - 1)] = c;
+    serial_tx_bytes++;
+}
+
+void serial_write(const char* data, size_t size) {
+    if (!serial_present) return;
+    for (size_t i = 0; i < size; i++) {
+        char c = data[i];
+        if (c == '\n') serial_put('\r');
+        serial_put(c);
+        if (c == '\b') {
+            serial_put(' ');
+            serial_put('\b');
+        }
+    }
+    serial_poll();
+}
+
+int serial_getchar() {
+    if (serial_rx_tail == serial_rx_head) return -1;
+    uint8_t c = serial_rx[serial_rx_tail++ & (SERIAL_RX_RING - 1)];
+    if (c == '\r') return '\n';
+    if (c == 0x7F) return '\b';
+    return c;
+}
@@ -0,0 +1,121 @@
+#include "pring.h"
+#include <stddef.h>
+
+uint32_t next_pid = 1;
+uintptr_t task_boot_sp;
+bool task_started = false;
+static uint8_t* task_free_stacks[MAX_PROCESSES];
+static int task_free_count = 0;
+
+void task_switch(uintptr_t* save_sp, uintptr_t next_sp);
+asm(".text\n"
+    ".global task_switch\n"
+    "task_switch:\n"
+    "    pushq %rbp\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    "    movq %rsp, (%rdi)\n"
+    "    movq %rsi, %rsp\n"
+    "    popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    popq %rbp\n"
+    "    ret\n");
+
+static void task_entry() {
+    ((void (*)(void))processes[current_process].entry_point)();
+    sys_exit(0);
+    while (1) task_yield();
+}
+
+int task_create(const char* name, void (*entry)(void), int tty, void* arg) {
+    if (process_count >= MAX_PROCESSES) return -1;
+    uint8_t* stack = task_free_count > 0 ? task_free_stacks[--task_free_count] : malloc(TASK_STACK_SIZE);
+    if (stack == NULL) return -1;
+    Process* p = &processes[process_count];
+    memset(p, 0, sizeof(Process));
+    p->pid = next_pid++;
+    p->pgid = p->pid;
+    strncpy(p->name, name, sizeof(p->name) - 1);
+    p->state = PROC_RUNNING;
+    p->entry_point = (uintptr_t)entry;
+    p->tty = tty;
+    p->cwd = current_inode;
+    p->stack = stack;
+    p->arg = arg;
+    p->out = terminal_out;
+    p->in = terminal_in;
+    uintptr_t* sp = (uintptr_t*)(((uintptr_t)stack + TASK_STACK_SIZE) & ~(uintptr_t)15);
+    *--sp = 0;
+    *--sp = (uintptr_t)task_entry;
+    for (int i = 0; i < 6; i++) *--sp = 0;
+    p->stack_ptr = (uintptr_t)sp;
+    process_count++;
+    return p->pid;
+}
+
+__attribute__((noinline)) void task_yield() {
+    if (!task_started) return;
+    serial_poll();
+    int next = current_process;
+    for (int n = 0; n < process_count; n++) {
+        next = next + 1 < process_count ? next + 1 : 0;
+        if (processes[next].stack != NULL && processes[next].state == PROC_RUNNING) break;
+    }
+    if (next == current_process) return;
+    Process* prev = &processes[current_process];
+    prev->out = terminal_out;
+    prev->in = terminal_in;
+    prev->cwd = current_inode;
+    current_process = next;
+    terminal_out = processes[next].out;
+    terminal_in = processes[next].in;
+    terminal_bind(&ttys[processes[next].tty]);
+    current_inode = processes[next].cwd;
+    task_switch(&prev->stack_ptr, processes[next].stack_ptr);
+}
+
+bool task_reap(uint32_t pid) {
+    for (int i = 0; i < process_count; i++) {
+        if (processes[i].pid != pid) continue;
+        if (processes[i].state != PROC_ZOMBIE || i == current_process) return false;
+        if (processes[i].stack != NULL) task_free_stacks[task_free_count++] = processes[i].stack;
+        for (int j = i; j < process_count - 1; j++) {
+            processes[j] = processes[j + 1];
+        }
+        process_count--;
+        if (i < current_process) current_process--;
+        return true;
+    }
+    return false;
+}
+
+Process* task_find(uint32_t pid) {
+    for (int i = 0; i < process_count; i++) {
+        if (processes[i].pid == pid) return &processes[i];
+    }
+    return NULL;
+}
+
+bool task_alive(uint32_t pid) {
+    for (int i = 0; i < process_count; i++) {
+        if (processes[i].pid == pid) return processes[i].state != PROC_ZOMBIE;
+    }
+    return false;
+}
+
+void task_start() {
+    for (int i = 0; i < process_count; i++) {
+        if (processes[i].stack == NULL) continue;
+        task_started = true;
+        current_process = i;
+        terminal_bind(&ttys[processes[i].tty]);
+        current_inode = processes[i].cwd;
+        task_switch(&task_boot_sp, processes[i].stack_ptr);
+    }
+}
@@ -0,0 +1,113 @@
+#include "pring.h"
+#include <stddef.h>
+
+uint8_t old_vga_font[VGA_FONT_SIZE];
+static uint8_t vga_font_shadow[VGA_FONT_SIZE];
+static uint8_t vga_font_cache[VGA_FONT_SLOTS][VGA_FONT_SIZE];
+static int vga_font_ids[VGA_FONT_SLOTS] = {-1, -1, -1, -1};
+static bool vga_font_captured = false;
+int vga_font_current = -1;
+uint32_t vga_font_uploads = 0;
+
+static uint8_t vga_font_saved_regs[5];
+
+static uint8_t vga_reg_swap(uint16_t port, uint8_t index, uint8_t value) {
+    outb(port, index);
+    uint8_t old = inb(port + 1);
+    outb(port + 1, value);
+    return old;
+}
+
+static void vga_font_plane_begin() {
+    vga_font_saved_regs[0] = vga_reg_swap(0x3C4, 0x02, 0x04);
+    vga_font_saved_regs[1] = vga_reg_swap(0x3C4, 0x04, 0x07);
+    vga_font_saved_regs[2] = vga_reg_swap(0x3CE, 0x04, 0x02);
+    vga_font_saved_regs[3] = vga_reg_swap(0x3CE, 0x05, 0x00);
+    vga_font_saved_regs[4] = vga_reg_swap(0x3CE, 0x06, 0x04);
+}
+
+static void vga_font_plane_end() {
+    vga_reg_swap(0x3C4, 0x02, vga_font_saved_regs[0]);
+    vga_reg_swap(0x3C4, 0x04, vga_font_saved_regs[1]);
+    vga_reg_swap(0x3CE, 0x04, vga_font_saved_regs[2]);
+    vga_reg_swap(0x3CE, 0x05, vga_font_saved_regs[3]);
+    vga_reg_swap(0x3CE, 0x06, vga_font_saved_regs[4]);
+}
+
+void vga_save_current_font(uint8_t* buffer) {
+    vga_font_plane_begin();
+    for (int c = 0; c < 256; c++) {
+        volatile uint64_t* src = (volatile uint64_t*)(uintptr_t)(VGA_FONT_PLANE + c * VGA_FONT_STRIDE);
+        for (int w = 0; w < VGA_FONT_HEIGHT / 8; w++) {
+            uint64_t v = src[w];
+            memcpy(buffer + c * VGA_FONT_HEIGHT + w * 8, &v, 8);
+        }
+    }
+    vga_font_plane_end();
+}
+
+void vga_font_capture() {
+    if (vga_font_captured || fb_console) return;
+    vga_save_current_font(old_vga_font);
+    memcpy(vga_font_shadow, old_vga_font, VGA_FONT_SIZE);
+    vga_font_captured = true;
+    vga_font_register(VGA_FONT_ORIGINAL, old_vga_font);
+    vga_font_current = VGA_FONT_ORIGINAL;
+}
+
+int vga_font_register(int id, const uint8_t* font) {
+    int slot = -1;
+    for (int i = 0; i < VGA_FONT_SLOTS; i++) {
+        if (vga_font_ids[i] == id) {
+            slot = i;
+            break;
+        }
+        if (slot == -1 && vga_font_ids[i] == -1) slot = i;
+    }
+    if (slot == -1) return -1;
+    memcpy(vga_font_cache[slot], font, VGA_FONT_SIZE);
+    vga_font_ids[slot] = id;
+    if (vga_font_current == id) vga_font_current = -1;
+    return slot;
+}
+
+void vga_set_font(const uint8_t* new_font) {
+    if (fb_console) return;
+    vga_font_capture();
+    uint32_t uploaded = 0;
+    vga_font_plane_begin();
+    for (int c = 0; c < 256; c++) {
+        const uint8_t* glyph = new_font + c * VGA_FONT_HEIGHT;
+        uint8_t* shadow = vga_font_shadow + c * VGA_FONT_HEIGHT;
+        if (memcmp(glyph, shadow, VGA_FONT_HEIGHT) == 0) continue;
+        volatile uint64_t* dst = (volatile uint64_t*)(uintptr_t)(VGA_FONT_PLANE + c * VGA_FONT_STRIDE);
+        for (int w = 0; w < VGA_FONT_HEIGHT / 8; w++) {
+            uint64_t v;
+            memcpy(&v, glyph + w * 8, 8);
+            dst[w] = v;
+        }
+        memcpy(shadow, glyph, VGA_FONT_HEIGHT);
+        uploaded++;
+    }
+    vga_font_plane_end();
+
+    outb(0x3D4, 0x09);
+    outb(0x3D5, (inb(0x3D5) & 0xE0) | (VGA_FONT_HEIGHT - 1));
+    vga_font_uploads += uploaded;
+    vga_font_current = -1;
+}
+
+bool vga_font_load(int id) {
+    if (vga_font_current == id) return true;
+    for (int i = 0; i < VGA_FONT_SLOTS; i++) {
+        if (vga_font_ids[i] != id) continue;
+        vga_set_font(vga_font_cache[i]);
+        vga_font_current = id;
+        return true;
+    }
+    return false;
+}
+
+void vga_restore_font(void) {
+    if (vga_font_captured) vga_font_load(VGA_FONT_ORIGINAL);
+}